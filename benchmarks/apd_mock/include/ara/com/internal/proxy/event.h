@@ -0,0 +1,129 @@
+/*
+ * Copyright (C) 2020 TU Dresden
+ * All rights reserved.
+ *
+ * Authors:
+ *   Christian Menard
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+#include "ara/com/internal/timestamp.h"
+#include "ara/com/types.h"
+
+namespace ara {
+namespace com {
+namespace internal {
+namespace proxy {
+
+// In-process stand-in for a proxy event. Samples are delivered directly by a
+// connected skeleton::EventDispatcher. Update() attaches the timestamp of each
+// new sample to it via dear::TimeContext. In addition, it provides the
+// timestamp of the newest cached sample until Cleanup() is called.
+template <class T>
+class Event {
+ private:
+  struct Received {
+    SamplePtr<const T> sample;
+    reactor::TimePoint timestamp;
+  };
+
+  std::mutex mutex;
+  std::vector<Received> incoming;
+  std::function<void()> receive_handler;
+  bool subscribed{false};
+  EventCacheUpdatePolicy policy{EventCacheUpdatePolicy::kNewestN};
+  std::size_t cache_size{0};
+
+  std::vector<SamplePtr<const T>> cache;
+  reactor::TimePoint cache_timestamp;
+  bool timestamp_provided{false};
+
+ public:
+  void Subscribe(EventCacheUpdatePolicy policy, std::size_t cache_size) {
+    std::lock_guard<std::mutex> lock(mutex);
+    this->policy = policy;
+    this->cache_size = cache_size;
+    subscribed = true;
+  }
+
+  void Unsubscribe() {
+    std::lock_guard<std::mutex> lock(mutex);
+    subscribed = false;
+    incoming.clear();
+  }
+
+  void SetReceiveHandler(std::function<void()> handler) {
+    std::lock_guard<std::mutex> lock(mutex);
+    receive_handler = std::move(handler);
+  }
+
+  void UnsetReceiveHandler() {
+    std::lock_guard<std::mutex> lock(mutex);
+    receive_handler = nullptr;
+  }
+
+  bool Update() {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (policy == EventCacheUpdatePolicy::kLastN) {
+      cache.clear();
+    }
+    for (auto& received : incoming) {
+      ProvideSampleTimestamp(received.sample.get(), received.timestamp);
+      cache.push_back(std::move(received.sample));
+      cache_timestamp = received.timestamp;
+    }
+    bool updated = !incoming.empty();
+    incoming.clear();
+
+    // drop the oldest samples that do not fit into the cache
+    if (cache.size() > cache_size) {
+      cache.erase(cache.begin(), cache.end() - cache_size);
+    }
+
+    if (!cache.empty() && !timestamp_provided) {
+      ProvideTimestamp(cache_timestamp);
+      timestamp_provided = true;
+    }
+    return updated;
+  }
+
+  const std::vector<SamplePtr<const T>>& GetCachedSamples() const {
+    return cache;
+  }
+
+  void Cleanup() {
+    cache.clear();
+    if (timestamp_provided) {
+      InvalidateTimestamp();
+      timestamp_provided = false;
+    }
+  }
+
+  // Only available in the mock. Called by a connected EventDispatcher.
+  void Deliver(SamplePtr<const T> sample, const reactor::TimePoint& timestamp) {
+    std::function<void()> handler;
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      if (!subscribed) {
+        return;
+      }
+      incoming.push_back(Received{std::move(sample), timestamp});
+      handler = receive_handler;
+    }
+    if (handler) {
+      handler();
+    }
+  }
+};
+
+}  // namespace proxy
+}  // namespace internal
+}  // namespace com
+}  // namespace ara
@@ -0,0 +1,148 @@
+/*
+ * Copyright (C) 2020 TU Dresden
+ * All rights reserved.
+ *
+ * Authors:
+ *   Christian Menard
+ */
+
+#pragma once
+
+#include <cassert>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+#include "ara/com/internal/sim/network.h"
+#include "ara/com/internal/timestamp.h"
+#include "ara/core/promise.h"
+
+namespace ara {
+namespace com {
+namespace internal {
+namespace proxy {
+
+template <class Signature>
+class Method;
+
+// In-process stand-in for a proxy method. Calls are forwarded synchronously
+// to the bound handler, typically SkeletonMethodTransactor::process_request.
+// If the method is bound via simulated links, requests and responses travel
+// over these links instead, and the handler is invoked by the thread that
+// runs the network.
+template <class R, class... Args>
+class Method<R(Args...)> {
+ private:
+  using Handler = std::function<ara::core::Future<R>(const Args&...)>;
+
+  Handler handler;
+  sim::Link* request_link{nullptr};
+  sim::Link* response_link{nullptr};
+
+  // Futures returned by the handler that are not completed yet. They are
+  // kept here rather than in their own continuation, which would keep the
+  // shared state alive forever if the handler never completes them.
+  std::mutex mutex;
+  std::uint64_t next_call{0};
+  std::map<std::uint64_t, ara::core::Future<R>> pending;
+
+  ara::core::Future<R> call_remote(const Args&... args) {
+    reactor::TimePoint timestamp;
+    bool valid = RetrieveTimestamp(&timestamp);
+    assert(valid);
+    (void)valid;
+
+    auto promise = std::make_shared<ara::core::Promise<R>>();
+    auto future = promise->get_future();
+    request_link->transmit(
+        timestamp, [this, promise, arguments = std::make_tuple(args...)](
+                       const reactor::TimePoint& timestamp) {
+          ProvideTimestamp(timestamp);
+          auto response = std::apply(handler, arguments);
+          InvalidateTimestamp();
+          receive_request(std::move(response), promise);
+        });
+    return future;
+  }
+
+  void receive_request(ara::core::Future<R>&& response,
+                       std::shared_ptr<ara::core::Promise<R>> promise) {
+    std::uint64_t call;
+    ara::core::Future<R>* future;
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      call = next_call++;
+      future = &pending.emplace(call, std::move(response)).first->second;
+    }
+    // invoked on the thread that completes the response, which provides the
+    // timestamp of the response
+    future->then([this, call, promise]() { send_response(call, promise); });
+  }
+
+  void send_response(std::uint64_t call,
+                     std::shared_ptr<ara::core::Promise<R>> promise) {
+    reactor::TimePoint timestamp;
+    bool valid = RetrieveTimestamp(&timestamp);
+    assert(valid);
+    (void)valid;
+
+    ara::core::Future<R> future;
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      auto it = pending.find(call);
+      future = std::move(it->second);
+      pending.erase(it);
+    }
+    auto result = std::make_shared<ara::core::Result<R>>(future.GetResult());
+    response_link->transmit(
+        timestamp,
+        [promise, result](const reactor::TimePoint& timestamp) {
+          ProvideTimestamp(timestamp);
+          if (!result->HasValue()) {
+            promise->SetError(result->Error());
+          } else if constexpr (std::is_void<R>::value) {
+            promise->set_value();
+          } else {
+            promise->set_value(result->Value());
+          }
+          InvalidateTimestamp();
+        });
+  }
+
+ public:
+  ara::core::Future<R> operator()(const Args&... args) {
+    if (!handler) {
+      // nobody is listening, the future never completes
+      return ara::core::Promise<R>().get_future();
+    }
+    if (request_link != nullptr) {
+      return call_remote(args...);
+    }
+    return handler(args...);
+  }
+
+  // Only available in the mock.
+  template <class F>
+  void Bind(F&& handler) {
+    this->handler = std::forward<F>(handler);
+  }
+
+  // Only available in the mock. Requests are sent via request_link and
+  // responses via response_link. Both links must outlive all calls.
+  template <class F>
+  void Bind(F&& handler, sim::Link* request_link, sim::Link* response_link) {
+    this->handler = std::forward<F>(handler);
+    this->request_link = request_link;
+    this->response_link = response_link;
+  }
+};
+
+}  // namespace proxy
+}  // namespace internal
+}  // namespace com
+}  // namespace ara
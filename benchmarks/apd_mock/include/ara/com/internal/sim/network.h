@@ -0,0 +1,166 @@
+/*
+ * Copyright (C) 2020 TU Dresden
+ * All rights reserved.
+ *
+ * Authors:
+ *   Christian Menard
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <random>
+#include <vector>
+
+#include <reactor-cpp/time.hh>
+
+namespace ara {
+namespace com {
+namespace internal {
+namespace sim {
+
+// Draws the latency of a single message.
+using LatencyDistribution = std::function<reactor::Duration(std::mt19937_64&)>;
+
+LatencyDistribution constant_latency(reactor::Duration latency);
+LatencyDistribution uniform_latency(reactor::Duration min,
+                                    reactor::Duration max);
+// Samples below zero are clamped to zero.
+LatencyDistribution normal_latency(reactor::Duration mean,
+                                   reactor::Duration stddev);
+// A fixed minimum plus an exponentially distributed queueing delay.
+LatencyDistribution exponential_latency(reactor::Duration min,
+                                        reactor::Duration mean_queueing);
+
+struct LinkModel {
+  LatencyDistribution latency{constant_latency(reactor::Duration::zero())};
+  // additional delay, drawn uniformly from [0, jitter] for each message
+  reactor::Duration jitter{reactor::Duration::zero()};
+  // probability that a message is lost
+  double loss{0.0};
+  // How far the clock of the receiver is ahead of the clock of the sender.
+  // It is added to the timestamp of each message.
+  reactor::Duration clock_skew{reactor::Duration::zero()};
+  // If set, messages never overtake each other, like on a TCP connection.
+  bool in_order{true};
+};
+
+class Network;
+
+// A one-way connection between two simulated nodes.
+class Link {
+ private:
+  Network& network;
+  const LinkModel model;
+
+  std::mutex mutex;
+  std::mt19937_64 rng;
+  reactor::TimePoint last_delivery;
+
+  std::atomic<std::uint64_t> sent_{0};
+  std::atomic<std::uint64_t> lost_{0};
+
+ public:
+  using Deliver = std::function<void(const reactor::TimePoint& timestamp)>;
+
+  Link(Network& network, const LinkModel& model, std::uint64_t seed);
+
+  Link(const Link&) = delete;
+  Link& operator=(const Link&) = delete;
+
+  // Sends a message that carries the given timestamp. The message arrives
+  // in virtual time at its timestamp plus the latency drawn for it. Unless
+  // the message is lost, deliver is invoked by the thread that runs the
+  // network once the message arrived, with the timestamp as seen by the
+  // receiver. The timestamp is transmitted in the trailer defined by
+  // dear/vsomeip_time.hh.
+  void transmit(const reactor::TimePoint& timestamp, Deliver deliver);
+
+  std::uint64_t sent() const { return sent_.load(std::memory_order_relaxed); }
+  std::uint64_t lost() const { return lost_.load(std::memory_order_relaxed); }
+};
+
+// Simulates the network between any number of nodes in-process and in
+// virtual time. All messages in flight are kept in a single event queue
+// ordered by their arrival time. The network has no thread of its own and
+// never waits for the physical clock. Instead, run_until() works off all
+// messages that arrive before a given virtual time on the calling thread,
+// as fast as the receivers take them. Thus, thousands of links cost no
+// thread at all, and messages with the same arrival time are delivered in
+// the order they were sent.
+//
+// A message arrives at its timestamp plus the latency of the link. In DEAR,
+// the timestamp of a message is the tag at which it was sent plus the
+// deadline of the sender, so the latency models the time the message
+// travels beyond the bound the sender guarantees.
+class Network {
+ private:
+  struct Delivery {
+    reactor::TimePoint time;
+    std::uint64_t sequence;
+    std::function<void()> deliver;
+
+    bool operator>(const Delivery& other) const {
+      return time != other.time ? time > other.time
+                                : sequence > other.sequence;
+    }
+  };
+
+  const std::uint64_t seed;
+
+  mutable std::mutex mutex;
+  std::priority_queue<Delivery, std::vector<Delivery>, std::greater<Delivery>>
+      queue;
+  std::uint64_t next_sequence{0};
+  reactor::TimePoint now_{};
+  std::vector<std::unique_ptr<Link>> links;
+
+  std::atomic<std::uint64_t> delivered_{0};
+
+  std::size_t deliver_before(const reactor::TimePoint& time);
+
+ public:
+  explicit Network(std::uint64_t seed = 0);
+
+  Network(const Network&) = delete;
+  Network& operator=(const Network&) = delete;
+
+  // Creates a new link. The link lives as long as the network. Each link
+  // draws from its own random number generator, so the behavior of a link
+  // does not depend on the traffic on other links.
+  Link* add_link(const LinkModel& model);
+
+  // Invokes deliver at the given virtual time. Messages that are scheduled
+  // for a time that already passed are delivered next.
+  void schedule(const reactor::TimePoint& time, std::function<void()> deliver);
+
+  // Delivers all messages that arrive before the given virtual time in
+  // order of their arrival and advances the virtual time to it. Messages
+  // are delivered without holding any lock, so receivers may send new
+  // messages right away. Must not be called concurrently. Returns the
+  // number of delivered messages.
+  std::size_t run_until(const reactor::TimePoint& time);
+
+  // Delivers all messages in flight, including the ones sent in response.
+  std::size_t run();
+
+  // The arrival time of the message that is currently delivered, or the
+  // time passed to the last call of run_until().
+  reactor::TimePoint now() const;
+
+  std::uint64_t delivered() const {
+    return delivered_.load(std::memory_order_relaxed);
+  }
+  std::uint64_t lost() const;
+};
+
+}  // namespace sim
+}  // namespace internal
+}  // namespace com
+}  // namespace ara
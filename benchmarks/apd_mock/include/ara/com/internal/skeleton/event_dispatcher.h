@@ -0,0 +1,85 @@
+/*
+ * Copyright (C) 2020 TU Dresden
+ * All rights reserved.
+ *
+ * Authors:
+ *   Christian Menard
+ */
+
+#pragma once
+
+#include <cassert>
+#include <functional>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "ara/com/internal/proxy/event.h"
+#include "ara/com/internal/sim/network.h"
+#include "ara/com/internal/timestamp.h"
+
+namespace ara {
+namespace com {
+namespace internal {
+namespace skeleton {
+
+// In-process stand-in for a skeleton event. Send() copies the sample once,
+// which stands in for serialization, and delivers it to all connected proxy
+// events together with the timestamp provided via dear::TimeContext. Events
+// connected via a simulated link receive the sample once it arrived.
+template <class T>
+class EventDispatcher {
+ public:
+  using Receiver = std::function<void(SamplePtr<const T> sample,
+                                      const reactor::TimePoint& timestamp)>;
+
+ private:
+  struct Subscriber {
+    Receiver receiver;
+    sim::Link* link;
+  };
+
+  std::vector<Subscriber> subscribers;
+
+ public:
+  void Send(const T& data) {
+    reactor::TimePoint timestamp;
+    bool valid = RetrieveTimestamp(&timestamp);
+    assert(valid);
+    (void)valid;
+
+    auto sample = std::make_shared<const T>(data);
+    for (const auto& subscriber : subscribers) {
+      if (subscriber.link == nullptr) {
+        subscriber.receiver(sample, timestamp);
+      } else {
+        subscriber.link->transmit(
+            timestamp, [receiver = subscriber.receiver,
+                        sample](const reactor::TimePoint& timestamp) {
+              receiver(sample, timestamp);
+            });
+      }
+    }
+  }
+
+  // Only available in the mock.
+  void Connect(proxy::Event<T>* event, sim::Link* link = nullptr) {
+    Connect(
+        [event](SamplePtr<const T> sample,
+                const reactor::TimePoint& timestamp) {
+          event->Deliver(std::move(sample), timestamp);
+        },
+        link);
+  }
+
+  // Only available in the mock. Passes each sample to the given receiver
+  // instead of a proxy event.
+  void Connect(Receiver receiver, sim::Link* link = nullptr) {
+    subscribers.push_back(Subscriber{std::move(receiver), link});
+  }
+};
+
+}  // namespace skeleton
+}  // namespace internal
+}  // namespace com
+}  // namespace ara
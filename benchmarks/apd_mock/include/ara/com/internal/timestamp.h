@@ -0,0 +1,28 @@
+/*
+ * Copyright (C) 2020 TU Dresden
+ * All rights reserved.
+ *
+ * Authors:
+ *   Christian Menard
+ */
+
+#pragma once
+
+#include <reactor-cpp/time.hh>
+
+namespace ara {
+namespace com {
+namespace internal {
+
+// Hooks into dear::TimeContext, which stand in for the timestamp propagation
+// added to APD by the DEAR patches. They are defined out of line to avoid a
+// cyclic include of dear/apd_dependencies.hh.
+bool RetrieveTimestamp(reactor::TimePoint* timestamp);
+void ProvideTimestamp(const reactor::TimePoint& timestamp);
+void InvalidateTimestamp();
+void ProvideSampleTimestamp(const void* sample,
+                            const reactor::TimePoint& timestamp);
+
+}  // namespace internal
+}  // namespace com
+}  // namespace ara
@@ -0,0 +1,32 @@
+/*
+ * Copyright (C) 2020 TU Dresden
+ * All rights reserved.
+ *
+ * Authors:
+ *   Christian Menard
+ */
+
+#pragma once
+
+#include <vsomeip/vsomeip.hpp>
+
+// The mock does not serialize any arguments. The (de)serializers are only
+// declared so that dear/apd_dependencies.hh can refer to them. Simulated links
+// transmit the timestamp of each message in the trailer of a vsomeip payload.
+namespace ara {
+namespace com {
+namespace internal {
+namespace vsomeip {
+namespace common {
+
+template <class T>
+class Deserializer;
+
+template <class... T>
+class Unmarshaller;
+
+}  // namespace common
+}  // namespace vsomeip
+}  // namespace internal
+}  // namespace com
+}  // namespace ara
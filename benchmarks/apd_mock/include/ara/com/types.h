@@ -0,0 +1,27 @@
+/*
+ * Copyright (C) 2020 TU Dresden
+ * All rights reserved.
+ *
+ * Authors:
+ *   Christian Menard
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <memory>
+
+namespace ara {
+namespace com {
+
+enum class EventCacheUpdatePolicy { kLastN, kNewestN };
+
+template <class T>
+using SamplePtr = std::shared_ptr<T>;
+
+namespace internal {
+using InstanceId = std::uint16_t;
+}
+
+}  // namespace com
+}  // namespace ara
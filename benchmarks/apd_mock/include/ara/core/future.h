@@ -0,0 +1,101 @@
+/*
+ * Copyright (C) 2020 TU Dresden
+ * All rights reserved.
+ *
+ * Authors:
+ *   Christian Menard
+ */
+
+#pragma once
+
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <type_traits>
+#include <utility>
+
+#include "ara/core/result.h"
+
+namespace ara {
+namespace core {
+
+namespace internal {
+
+// State shared by a promise and its future. The continuation registered via
+// then() is invoked on the thread that sets the result, just like in APD.
+template <class T, class E>
+struct SharedState {
+  std::mutex mutex;
+  std::condition_variable cv;
+  std::optional<Result<T, E>> result;
+  std::function<void()> continuation;
+
+  void set(Result<T, E>&& value) {
+    std::function<void()> callback;
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      result.emplace(std::move(value));
+      callback = std::move(continuation);
+      continuation = nullptr;
+    }
+    cv.notify_all();
+    if (callback) {
+      callback();
+    }
+  }
+};
+
+}  // namespace internal
+
+template <class T, class E = ErrorCode>
+class Future {
+ private:
+  std::shared_ptr<internal::SharedState<T, E>> state;
+
+ public:
+  Future() = default;
+  explicit Future(std::shared_ptr<internal::SharedState<T, E>> state)
+      : state(std::move(state)) {}
+
+  Future(Future&&) = default;
+  Future& operator=(Future&&) = default;
+  Future(const Future&) = delete;
+  Future& operator=(const Future&) = delete;
+
+  bool valid() const { return state != nullptr; }
+
+  bool is_ready() const {
+    std::lock_guard<std::mutex> lock(state->mutex);
+    return state->result.has_value();
+  }
+
+  template <class F>
+  void then(F&& callback) {
+    std::unique_lock<std::mutex> lock(state->mutex);
+    if (state->result.has_value()) {
+      lock.unlock();
+      callback();
+    } else {
+      state->continuation = std::forward<F>(callback);
+    }
+  }
+
+  Result<T, E> GetResult() {
+    std::unique_lock<std::mutex> lock(state->mutex);
+    state->cv.wait(lock, [this]() { return state->result.has_value(); });
+    return *state->result;
+  }
+
+  T get() {
+    if constexpr (std::is_void<T>::value) {
+      GetResult();
+    } else {
+      return GetResult().Value();
+    }
+  }
+};
+
+}  // namespace core
+}  // namespace ara
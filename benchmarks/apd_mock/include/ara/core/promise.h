@@ -0,0 +1,67 @@
+/*
+ * Copyright (C) 2020 TU Dresden
+ * All rights reserved.
+ *
+ * Authors:
+ *   Christian Menard
+ */
+
+#pragma once
+
+#include <memory>
+#include <utility>
+
+#include "ara/core/future.h"
+
+namespace ara {
+namespace core {
+
+// A promise that is destroyed without a value never completes its future.
+// This mimics a service that does not send a response.
+template <class T, class E = ErrorCode>
+class Promise {
+ private:
+  std::shared_ptr<internal::SharedState<T, E>> state{
+      std::make_shared<internal::SharedState<T, E>>()};
+
+ public:
+  Promise() = default;
+  Promise(Promise&&) = default;
+  Promise& operator=(Promise&&) = default;
+  Promise(const Promise&) = delete;
+  Promise& operator=(const Promise&) = delete;
+
+  Future<T, E> get_future() { return Future<T, E>(state); }
+
+  void set_value(const T& value) {
+    state->set(Result<T, E>::FromValue(value));
+  }
+  void set_value(T&& value) {
+    state->set(Result<T, E>::FromValue(std::move(value)));
+  }
+  void SetError(const E& error) { state->set(Result<T, E>::FromError(error)); }
+};
+
+template <class E>
+class Promise<void, E> {
+ private:
+  std::shared_ptr<internal::SharedState<void, E>> state{
+      std::make_shared<internal::SharedState<void, E>>()};
+
+ public:
+  Promise() = default;
+  Promise(Promise&&) = default;
+  Promise& operator=(Promise&&) = default;
+  Promise(const Promise&) = delete;
+  Promise& operator=(const Promise&) = delete;
+
+  Future<void, E> get_future() { return Future<void, E>(state); }
+
+  void set_value() { state->set(Result<void, E>::FromValue()); }
+  void SetError(const E& error) {
+    state->set(Result<void, E>::FromError(error));
+  }
+};
+
+}  // namespace core
+}  // namespace ara
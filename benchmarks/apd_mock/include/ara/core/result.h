@@ -0,0 +1,80 @@
+/*
+ * Copyright (C) 2020 TU Dresden
+ * All rights reserved.
+ *
+ * Authors:
+ *   Christian Menard
+ */
+
+#pragma once
+
+#include <optional>
+#include <utility>
+
+namespace ara {
+namespace core {
+
+class ErrorCode {
+ private:
+  int value;
+
+ public:
+  explicit ErrorCode(int value = 0) : value(value) {}
+  int Value() const { return value; }
+};
+
+template <class T, class E = ErrorCode>
+class Result {
+ private:
+  std::optional<T> value_;
+  std::optional<E> error_;
+
+  Result() = default;
+
+ public:
+  static Result FromValue(const T& value) {
+    Result result;
+    result.value_ = value;
+    return result;
+  }
+
+  static Result FromValue(T&& value) {
+    Result result;
+    result.value_ = std::move(value);
+    return result;
+  }
+
+  static Result FromError(const E& error) {
+    Result result;
+    result.error_ = error;
+    return result;
+  }
+
+  bool HasValue() const { return value_.has_value(); }
+  const T& Value() const& { return *value_; }
+  T&& Value() && { return std::move(*value_); }
+  const E& Error() const& { return *error_; }
+};
+
+template <class E>
+class Result<void, E> {
+ private:
+  std::optional<E> error_;
+
+  Result() = default;
+
+ public:
+  static Result FromValue() { return Result(); }
+
+  static Result FromError(const E& error) {
+    Result result;
+    result.error_ = error;
+    return result;
+  }
+
+  bool HasValue() const { return !error_.has_value(); }
+  const E& Error() const& { return *error_; }
+};
+
+}  // namespace core
+}  // namespace ara
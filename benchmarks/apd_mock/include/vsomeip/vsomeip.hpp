@@ -0,0 +1,49 @@
+/*
+ * Copyright (C) 2020 TU Dresden
+ * All rights reserved.
+ *
+ * Authors:
+ *   Christian Menard
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <utility>
+#include <vector>
+
+// The parts of the vsomeip message API that dear/vsomeip_time.hh reads
+// timestamps from. Payloads own their data.
+namespace vsomeip {
+
+using byte_t = std::uint8_t;
+using length_t = std::uint32_t;
+
+class payload {
+ private:
+  std::vector<byte_t> data;
+
+ public:
+  payload() = default;
+  explicit payload(std::vector<byte_t>&& data) : data(std::move(data)) {}
+
+  byte_t* get_data() { return data.data(); }
+  const byte_t* get_data() const { return data.data(); }
+  length_t get_length() const { return static_cast<length_t>(data.size()); }
+
+  void set_data(std::vector<byte_t>&& data) { this->data = std::move(data); }
+};
+
+class message {
+ private:
+  std::shared_ptr<payload> payload_{std::make_shared<payload>()};
+
+ public:
+  std::shared_ptr<payload> get_payload() const { return payload_; }
+  void set_payload(std::shared_ptr<payload> new_payload) {
+    payload_ = std::move(new_payload);
+  }
+};
+
+}  // namespace vsomeip
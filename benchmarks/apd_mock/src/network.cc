@@ -0,0 +1,163 @@
+/*
+ * Copyright (C) 2020 TU Dresden
+ * All rights reserved.
+ *
+ * Authors:
+ *   Christian Menard
+ */
+
+#include "ara/com/internal/sim/network.h"
+
+#include <algorithm>
+#include <cassert>
+#include <memory>
+#include <vector>
+
+#include <vsomeip/vsomeip.hpp>
+
+#include "dear/vsomeip_time.hh"
+
+namespace ara {
+namespace com {
+namespace internal {
+namespace sim {
+
+LatencyDistribution constant_latency(reactor::Duration latency) {
+  return [latency](std::mt19937_64&) { return latency; };
+}
+
+LatencyDistribution uniform_latency(reactor::Duration min,
+                                    reactor::Duration max) {
+  std::uniform_int_distribution<reactor::Duration::rep> distribution{
+      min.count(), max.count()};
+  return [distribution](std::mt19937_64& rng) mutable {
+    return reactor::Duration{distribution(rng)};
+  };
+}
+
+LatencyDistribution normal_latency(reactor::Duration mean,
+                                   reactor::Duration stddev) {
+  std::normal_distribution<double> distribution{
+      static_cast<double>(mean.count()), static_cast<double>(stddev.count())};
+  return [distribution](std::mt19937_64& rng) mutable {
+    auto sample = std::max(distribution(rng), 0.0);
+    return reactor::Duration{static_cast<reactor::Duration::rep>(sample)};
+  };
+}
+
+LatencyDistribution exponential_latency(reactor::Duration min,
+                                        reactor::Duration mean_queueing) {
+  std::exponential_distribution<double> distribution{
+      1.0 / static_cast<double>(std::max<reactor::Duration::rep>(
+                mean_queueing.count(), 1))};
+  return [min, distribution](std::mt19937_64& rng) mutable {
+    return min +
+           reactor::Duration{
+               static_cast<reactor::Duration::rep>(distribution(rng))};
+  };
+}
+
+Link::Link(Network& network, const LinkModel& model, std::uint64_t seed)
+    : network(network), model(model), rng(seed) {}
+
+void Link::transmit(const reactor::TimePoint& timestamp, Deliver deliver) {
+  sent_.fetch_add(1, std::memory_order_relaxed);
+
+  reactor::TimePoint arrival;
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (model.loss > 0.0 &&
+        std::uniform_real_distribution<double>{0.0, 1.0}(rng) < model.loss) {
+      lost_.fetch_add(1, std::memory_order_relaxed);
+      return;
+    }
+    auto delay = model.latency(rng);
+    if (model.jitter > reactor::Duration::zero()) {
+      delay += reactor::Duration{
+          std::uniform_int_distribution<reactor::Duration::rep>{
+              0, model.jitter.count()}(rng)};
+    }
+    arrival = timestamp + delay;
+    if (model.in_order) {
+      arrival = std::max(arrival, last_delivery);
+      last_delivery = arrival;
+    }
+  }
+
+  // The timestamp travels in the trailer that the DEAR binding appends to
+  // the payload. The arguments are not serialized.
+  std::vector<::vsomeip::byte_t> data;
+  data.reserve(dear::trailer::kSize);
+  dear::append_timestamp_trailer(data, timestamp);
+  auto payload = std::make_shared<::vsomeip::payload>(std::move(data));
+  network.schedule(arrival, [deliver = std::move(deliver), payload,
+                             clock_skew = model.clock_skew]() {
+    auto received = dear::get_timestamp_from_trailer(*payload);
+    assert(received.HasValue());
+    deliver(received.Value() + clock_skew);
+  });
+}
+
+Network::Network(std::uint64_t seed) : seed(seed) {}
+
+Link* Network::add_link(const LinkModel& model) {
+  std::lock_guard<std::mutex> lock(mutex);
+  // derive a distinct seed for each link
+  links.push_back(std::make_unique<Link>(
+      *this, model, seed + 0x9e3779b97f4a7c15ull * (links.size() + 1)));
+  return links.back().get();
+}
+
+void Network::schedule(const reactor::TimePoint& time,
+                       std::function<void()> deliver) {
+  std::lock_guard<std::mutex> lock(mutex);
+  queue.push(
+      Delivery{std::max(time, now_), next_sequence++, std::move(deliver)});
+}
+
+std::size_t Network::deliver_before(const reactor::TimePoint& time) {
+  std::size_t count = 0;
+  std::unique_lock<std::mutex> lock(mutex);
+  while (!queue.empty() && queue.top().time < time) {
+    auto deliver = std::move(const_cast<Delivery&>(queue.top()).deliver);
+    now_ = queue.top().time;
+    queue.pop();
+    lock.unlock();
+    deliver();
+    count++;
+    lock.lock();
+  }
+  delivered_.fetch_add(count, std::memory_order_relaxed);
+  return count;
+}
+
+std::size_t Network::run_until(const reactor::TimePoint& time) {
+  auto count = deliver_before(time);
+  std::lock_guard<std::mutex> lock(mutex);
+  now_ = std::max(now_, time);
+  return count;
+}
+
+std::size_t Network::run() {
+  return deliver_before(reactor::TimePoint::max());
+}
+
+reactor::TimePoint Network::now() const {
+  std::lock_guard<std::mutex> lock(mutex);
+  return now_;
+}
+
+std::uint64_t Network::lost() const {
+  // add_link() may grow the vector concurrently
+  std::lock_guard<std::mutex> lock(mutex);
+  std::uint64_t result = 0;
+  for (const auto& link : links) {
+    result += link->lost();
+  }
+  return result;
+}
+
+}  // namespace sim
+}  // namespace internal
+}  // namespace com
+}  // namespace ara
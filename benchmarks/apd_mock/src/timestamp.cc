@@ -0,0 +1,39 @@
+/*
+ * Copyright (C) 2020 TU Dresden
+ * All rights reserved.
+ *
+ * Authors:
+ *   Christian Menard
+ */
+
+#include "ara/com/internal/timestamp.h"
+
+#include "dear/time_context.hh"
+
+namespace ara {
+namespace com {
+namespace internal {
+
+bool RetrieveTimestamp(reactor::TimePoint* timestamp) {
+  auto result = dear::TimeContext::retrieve_timestamp();
+  if (result.HasValue()) {
+    *timestamp = result.Value();
+    return true;
+  }
+  return false;
+}
+
+void ProvideTimestamp(const reactor::TimePoint& timestamp) {
+  dear::TimeContext::provide_timestamp(timestamp);
+}
+
+void InvalidateTimestamp() { dear::TimeContext::invalidate_timestamp(); }
+
+void ProvideSampleTimestamp(const void* sample,
+                            const reactor::TimePoint& timestamp) {
+  dear::TimeContext::provide_sample_timestamp(sample, timestamp);
+}
+
+}  // namespace internal
+}  // namespace com
+}  // namespace ara
@@ -0,0 +1,263 @@
+/*
+ * Copyright (C) 2020 TU Dresden
+ * All rights reserved.
+ *
+ * Authors:
+ *   Christian Menard
+ */
+
+// Measures delta encoding (see dear/delta_state.hh) of a large state of which
+// a varying fraction changes from one message to the next. A producer changes
+// randomly chosen blocks of a 1 MiB state and publishes it via a
+// DeltaStateSender, which is connected to a DeltaStateReceiver by a probe
+// reactor. The transport in between does not affect the quantities measured
+// here.
+//
+// For each changed fraction, reported are the mean size of the encoded
+// messages, also relative to the state size, and the time the receiver takes
+// to reconstruct the state (p50/p99), measured from the probe to the reaction
+// that consumes the reconstructed state. The first message, which is always a
+// keyframe, is not included. The row "keyframe" sends every message as a
+// keyframe, which is the cost without delta encoding. All reconstructed
+// states are compared with the original one, mismatches are reported as
+// errors.
+//
+// The program has no physical actions, so the environment runs in
+// fast-forward mode.
+//
+// Usage: delta_benchmark [messages] [workers]
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <numeric>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <reactor-cpp/reactor-cpp.hh>
+
+#include "dear/delta_state.hh"
+#include "dear/latency_histogram.hh"
+
+namespace {
+
+using namespace std::chrono_literals;
+
+constexpr std::size_t kStateSize = 1 << 20;
+constexpr std::size_t kBlockSize = 64;
+constexpr std::size_t kBlocks = kStateSize / kBlockSize;
+
+struct State {
+  std::uint8_t bytes[kStateSize];
+};
+
+using Message = std::vector<std::uint8_t>;
+
+struct Config {
+  std::size_t messages{1000};
+  unsigned workers{1};
+  reactor::Duration period{1ms};
+};
+
+// Results of a single run. Only accessed from reactions that depend on each
+// other, so no synchronization is needed.
+struct Measurement {
+  std::size_t messages{0};
+  std::uint64_t encoded_bytes{0};
+  reactor::TimePoint forwarded_at{};
+  dear::LatencyHistogram receive_time;
+  std::size_t received{0};
+  std::size_t errors{0};
+};
+
+// Periodically changes a fixed number of distinct, randomly chosen blocks of
+// the state and publishes it. Stops after the configured number of messages.
+class Producer : public reactor::Reactor {
+ private:
+  std::unique_ptr<State> state{std::make_unique<State>()};
+  std::vector<std::size_t> blocks;
+  std::size_t changed_blocks;
+  std::mt19937_64 rng{42};
+  const std::size_t messages;
+  std::size_t sent{0};
+
+  reactor::Timer timer;
+
+  // reactions
+  reactor::Reaction r_timer{"r_timer", 1, this, [this]() { on_timer(); }};
+
+  // reaction bodies
+  void on_timer() {
+    // the first changed_blocks entries of a partial Fisher-Yates shuffle
+    for (std::size_t i = 0; i < changed_blocks; i++) {
+      std::uniform_int_distribution<std::size_t> pick{i, kBlocks - 1};
+      std::swap(blocks[i], blocks[pick(rng)]);
+      state->bytes[blocks[i] * kBlockSize]++;
+    }
+    out.set(*state);
+    if (++sent == messages) {
+      environment()->sync_shutdown();
+    }
+  }
+
+ public:
+  // ports
+  reactor::Output<State> out{"out", this};
+
+  Producer(const std::string& name,
+           reactor::Environment* env,
+           const Config& config,
+           std::size_t changed_blocks)
+      : reactor::Reactor(name, env)
+      , blocks(kBlocks)
+      , changed_blocks(changed_blocks)
+      , messages(config.messages)
+      , timer("timer", this, config.period) {
+    std::memset(state.get(), 0, sizeof(State));
+    std::iota(blocks.begin(), blocks.end(), 0);
+  }
+
+  const State& current() const { return *state; }
+
+  void assemble() override {
+    r_timer.declare_trigger(&timer);
+    r_timer.declare_antidependency(&out);
+  }
+};
+
+// Forwards the encoded messages to the receiver and takes their size and the
+// time at which the receiver gets them.
+class Probe : public reactor::Reactor {
+ private:
+  Measurement& measurement;
+
+  // reactions
+  reactor::Reaction r_in{"r_in", 1, this, [this]() { on_in(); }};
+
+  // reaction bodies
+  void on_in() {
+    if (measurement.messages++ > 0) {
+      measurement.encoded_bytes += in.get()->size();
+    }
+    measurement.forwarded_at = reactor::get_physical_time();
+    out.set(in.get());
+  }
+
+ public:
+  // ports
+  reactor::Input<Message> in{"in", this};
+  reactor::Output<Message> out{"out", this};
+
+  Probe(const std::string& name,
+        reactor::Environment* env,
+        Measurement& measurement)
+      : reactor::Reactor(name, env), measurement(measurement) {}
+
+  void assemble() override {
+    r_in.declare_trigger(&in);
+    r_in.declare_antidependency(&out);
+  }
+};
+
+// Takes the time at which the reconstructed state arrives and checks it
+// against the state of the producer.
+class Sink : public reactor::Reactor {
+ private:
+  Measurement& measurement;
+  const Producer& producer;
+
+  // reactions
+  reactor::Reaction r_in{"r_in", 1, this, [this]() { on_in(); }};
+
+  // reaction bodies
+  void on_in() {
+    auto now = reactor::get_physical_time();
+    if (measurement.received++ > 0) {
+      measurement.receive_time.record(now - measurement.forwarded_at);
+    }
+    const auto& state = *in.get();
+    if (std::memcmp(state.get(), &producer.current(), sizeof(State)) != 0) {
+      measurement.errors++;
+    }
+  }
+
+ public:
+  // ports
+  reactor::Input<std::shared_ptr<const State>> in{"in", this};
+
+  Sink(const std::string& name,
+       reactor::Environment* env,
+       Measurement& measurement,
+       const Producer& producer)
+      : reactor::Reactor(name, env)
+      , measurement(measurement)
+      , producer(producer) {}
+
+  void assemble() override { r_in.declare_trigger(&in); }
+};
+
+void run(const Config& config,
+         const char* label,
+         std::size_t changed_blocks,
+         std::uint32_t keyframe_interval) {
+  dear::DeltaOptions options;
+  options.block_size = kBlockSize;
+  options.keyframe_interval = keyframe_interval;
+
+  Measurement measurement;
+  reactor::Environment env{config.workers, false, true};
+  Producer producer{"producer", &env, config, changed_blocks};
+  dear::DeltaStateSender<State> sender{"sender", &env, options};
+  Probe probe{"probe", &env, measurement};
+  dear::DeltaStateReceiver<State> receiver{"receiver", &env};
+  Sink sink{"sink", &env, measurement, producer};
+
+  producer.out.bind_to(&sender.notify);
+  sender.delta.bind_to(&probe.in);
+  probe.out.bind_to(&receiver.delta);
+  receiver.notify.bind_to(&sink.in);
+
+  env.assemble();
+  auto thread = env.startup();
+  thread.join();
+
+  auto deltas = std::max<std::size_t>(measurement.messages, 2) - 1;
+  auto bytes = static_cast<double>(measurement.encoded_bytes) /
+               static_cast<double>(deltas);
+  std::chrono::duration<double, std::micro> p50 =
+      measurement.receive_time.value_at_percentile(50.0);
+  std::chrono::duration<double, std::micro> p99 =
+      measurement.receive_time.value_at_percentile(99.0);
+  std::printf("%-10s %12.0f %9.4f %13.1f %13.1f %7zu\n", label, bytes,
+              bytes / static_cast<double>(kStateSize), p50.count(),
+              p99.count(), measurement.errors + receiver.dropped_messages());
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  Config config;
+  if (argc > 1) {
+    config.messages = std::stoul(argv[1]);
+  }
+  if (argc > 2) {
+    config.workers = static_cast<unsigned>(std::stoul(argv[2]));
+  }
+
+  std::printf("%-10s %12s %9s %13s %13s %7s\n", "changed[%]", "bytes/msg",
+              "ratio", "recv p50[us]", "recv p99[us]", "errors");
+  for (double percent : {0.1, 1.0, 10.0, 50.0, 100.0}) {
+    char label[16];
+    std::snprintf(label, sizeof(label), "%.1f", percent);
+    auto changed_blocks = static_cast<std::size_t>(
+        percent / 100.0 * static_cast<double>(kBlocks));
+    // only the first message is a keyframe
+    run(config, label, changed_blocks, 0);
+  }
+  run(config, "keyframe", kBlocks, 1);
+  return 0;
+}
@@ -0,0 +1,225 @@
+/*
+ * Copyright (C) 2020 TU Dresden
+ * All rights reserved.
+ *
+ * Authors:
+ *   Christian Menard
+ */
+
+// Measures how shedding the receives of best effort topics protects critical
+// topics under overload. A few critical and many best effort topics send
+// events periodically. The reaction consuming each event spins for a fixed
+// amount of time, so that the best effort topics alone need more CPU time
+// than the reactor workers have. The benchmark runs once without and once
+// with shedding.
+//
+// Reported are, for each class of topics, the number of received and shed
+// events, and the lag between the release tag and the physical time at which
+// the consuming reaction ran (p50/p99/p999).
+//
+// Usage: overload_benchmark [critical] [best_effort] [work_us] [workers]
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <reactor-cpp/reactor-cpp.hh>
+
+#include "dear/transactor.hh"
+
+namespace {
+
+using namespace std::chrono_literals;
+
+using Payload = std::vector<std::uint8_t>;
+
+using EventDispatcher = dear::apd::skeleton::EventDispatcher<Payload>;
+using Event = dear::apd::proxy::Event<Payload>;
+
+using SkeletonEvent = dear::SkeletonEventTransactor<EventDispatcher>;
+using ProxyEvent = dear::ProxyEventTransactor<Event&>;
+
+struct Config {
+  std::size_t critical_topics{4};
+  std::size_t best_effort_topics{64};
+  reactor::Duration period{1ms};
+  reactor::Duration work{50us};
+  reactor::Duration duration{3s};
+  unsigned workers{2};
+
+  reactor::Duration deadline{1ms};
+  reactor::Duration max_network_delay{1ms};
+  reactor::Duration max_synchronization_error{1ms};
+
+  // best effort events are shed once the program lags this far behind
+  reactor::Duration shedding_threshold{2ms};
+};
+
+// A topic that periodically sends an event to itself and spins for the
+// configured time whenever it receives one.
+class Topic : public reactor::Reactor {
+ private:
+  EventDispatcher dispatcher;
+  Event event;
+
+  reactor::ImmutableValuePtr<Payload> payload;
+  const reactor::Duration work;
+
+  reactor::StartupAction startup{"startup", this};
+  reactor::Timer timer;
+
+  SkeletonEvent skeleton;
+  ProxyEvent proxy;
+
+  // reactions
+  reactor::Reaction r_startup{"r_startup", 1, this,
+                              [this]() { proxy.update_binding.set(&event); }};
+  reactor::Reaction r_timer{"r_timer", 2, this,
+                            [this]() { skeleton.notify.set(payload); }};
+  reactor::Reaction r_receive{"r_receive", 3, this, [this]() { on_receive(); }};
+
+  // reaction bodies
+  void on_receive() {
+    auto start = reactor::get_physical_time();
+    lags.push_back(start - get_logical_time());
+    while (reactor::get_physical_time() - start < work) {
+    }
+  }
+
+ public:
+  std::vector<reactor::Duration> lags;
+
+  Topic(const std::string& name,
+        reactor::Environment* env,
+        const Config& config,
+        reactor::Duration offset,
+        const dear::ProxyEventOptions& options)
+      : reactor::Reactor(name, env)
+      , payload(reactor::make_immutable_value<Payload>(64, 0xab))
+      , work(config.work)
+      , timer("timer", this, config.period, offset)
+      , skeleton("skeleton", this, &dispatcher, config.deadline)
+      , proxy("proxy",
+              this,
+              config.max_network_delay,
+              config.max_synchronization_error,
+              options) {
+    dispatcher.Connect(&event);
+  }
+
+  void assemble() override {
+    r_startup.declare_trigger(&startup);
+    r_startup.declare_antidependency(&proxy.update_binding);
+    r_timer.declare_trigger(&timer);
+    r_timer.declare_antidependency(&skeleton.notify);
+    r_receive.declare_trigger(&proxy.notify);
+  }
+
+  const ProxyEvent& receiver() const { return proxy; }
+};
+
+// Shuts down the environment after the configured duration.
+class Stopper : public reactor::Reactor {
+ private:
+  reactor::Timer timer;
+  reactor::Reaction r_stop{"r_stop", 1, this,
+                           [this]() { environment()->sync_shutdown(); }};
+
+ public:
+  Stopper(const std::string& name,
+          reactor::Environment* env,
+          reactor::Duration duration)
+      : reactor::Reactor(name, env), timer("timer", this, duration, duration) {}
+
+  void assemble() override { r_stop.declare_trigger(&timer); }
+};
+
+double to_us(reactor::Duration d) {
+  return std::chrono::duration<double, std::micro>(d).count();
+}
+
+void report(const char* run,
+            const char* criticality,
+            const std::vector<std::unique_ptr<Topic>>& topics) {
+  std::vector<reactor::Duration> lags;
+  std::uint64_t shed = 0;
+  for (const auto& topic : topics) {
+    lags.insert(lags.end(), topic->lags.begin(), topic->lags.end());
+    shed += topic->receiver().metrics().shed_messages.load();
+  }
+  std::sort(lags.begin(), lags.end());
+
+  auto percentile = [&lags](double p) {
+    if (lags.empty()) {
+      return reactor::Duration::zero();
+    }
+    auto index = static_cast<std::size_t>(p * lags.size());
+    return lags[std::min(index, lags.size() - 1)];
+  };
+
+  std::printf("%-10s %-12s %9zu %9lu %10.1f %10.1f %10.1f\n", run,
+              criticality, lags.size(), static_cast<unsigned long>(shed),
+              to_us(percentile(0.5)), to_us(percentile(0.99)),
+              to_us(percentile(0.999)));
+}
+
+void run(const char* name, const Config& config, bool shedding) {
+  reactor::Environment env{config.workers};
+  Stopper stopper{"stopper", &env, config.duration};
+
+  auto topic_count = config.critical_topics + config.best_effort_topics;
+  std::vector<std::unique_ptr<Topic>> critical;
+  std::vector<std::unique_ptr<Topic>> best_effort;
+  for (std::size_t i = 0; i < topic_count; i++) {
+    dear::ProxyEventOptions options;
+    options.shedding.criticality = i < config.critical_topics
+                                       ? dear::Criticality::kCritical
+                                       : dear::Criticality::kBestEffort;
+    if (shedding) {
+      options.shedding.best_effort_threshold = config.shedding_threshold;
+    }
+    auto offset = 10ms + config.period * i / topic_count;
+    auto topic = std::make_unique<Topic>("topic_" + std::to_string(i), &env,
+                                         config, offset, options);
+    if (i < config.critical_topics) {
+      critical.push_back(std::move(topic));
+    } else {
+      best_effort.push_back(std::move(topic));
+    }
+  }
+
+  env.assemble();
+  auto thread = env.startup();
+  thread.join();
+
+  report(name, "critical", critical);
+  report(name, "best_effort", best_effort);
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  Config config;
+  if (argc > 1) {
+    config.critical_topics = std::stoul(argv[1]);
+  }
+  if (argc > 2) {
+    config.best_effort_topics = std::stoul(argv[2]);
+  }
+  if (argc > 3) {
+    config.work = std::chrono::microseconds{std::stoul(argv[3])};
+  }
+  if (argc > 4) {
+    config.workers = static_cast<unsigned>(std::stoul(argv[4]));
+  }
+
+  std::printf("%-10s %-12s %9s %9s %10s %10s %10s\n", "run", "criticality",
+              "received", "shed", "p50[us]", "p99[us]", "p999[us]");
+  run("baseline", config, false);
+  run("shedding", config, true);
+  return 0;
+}
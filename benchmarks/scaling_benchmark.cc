@@ -0,0 +1,364 @@
+/*
+ * Copyright (C) 2020 TU Dresden
+ * All rights reserved.
+ *
+ * Authors:
+ *   Christian Menard
+ */
+
+// Measures how DEAR scales with the number of topics on a single host. Each
+// topic consists of a SkeletonEventTransactor and a ProxyEventTransactor that
+// are connected via a simulated network link (see
+// apd_mock/include/ara/com/internal/sim/network.h). Each link has its own
+// latency distribution, jitter, loss rate and clock skew, which is drawn
+// uniformly from [-max_synchronization_error, max_synchronization_error].
+//
+// The benchmark runs faster than real time. The publishers and their
+// skeleton transactors live in an environment that executes in fast-forward
+// mode, so their timers fire as fast as the workers process them. The
+// network runs in virtual time along with the logical time of the senders.
+// The proxy transactors live in a second environment that runs in physical
+// time, because they receive messages via physical actions, which reactor-cpp
+// tags with the physical clock. Each message is injected into its proxy
+// transactor with its virtual timestamp shifted by the difference between the
+// physical time of the injection and the virtual arrival time. Thus, the
+// slack between arrival and release tag, and whether a message is a timing
+// violation, is the same as in virtual time.
+//
+// Reported are the number of events sent, delivered by the network, and
+// received by the sinks, the number of events lost on the network or dropped
+// as timing violations, how far the sinks lag behind physical time (p99),
+// the achieved throughput and speedup over real time, and the heap memory per
+// topic. A topic consists of two transactors, the reactors driving them, and
+// the mock objects of the binding.
+//
+// Usage: scaling_benchmark [topics] [period_ms] [duration_ms] [workers]
+
+#include <malloc.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cinttypes>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <new>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <reactor-cpp/reactor-cpp.hh>
+
+#include "ara/com/internal/sim/network.h"
+#include "dear/latency_histogram.hh"
+#include "dear/transactor.hh"
+
+namespace {
+
+// heap memory currently in use
+std::atomic<std::int64_t> live_bytes{0};
+
+}  // namespace
+
+void* operator new(std::size_t size) {
+  void* p = std::malloc(size == 0 ? 1 : size);
+  if (p == nullptr) {
+    throw std::bad_alloc();
+  }
+  live_bytes.fetch_add(static_cast<std::int64_t>(malloc_usable_size(p)),
+                       std::memory_order_relaxed);
+  return p;
+}
+
+void* operator new[](std::size_t size) { return operator new(size); }
+
+void operator delete(void* p) noexcept {
+  if (p != nullptr) {
+    live_bytes.fetch_sub(static_cast<std::int64_t>(malloc_usable_size(p)),
+                         std::memory_order_relaxed);
+  }
+  std::free(p);
+}
+
+void operator delete[](void* p) noexcept { operator delete(p); }
+void operator delete(void* p, std::size_t) noexcept { operator delete(p); }
+void operator delete[](void* p, std::size_t) noexcept { operator delete(p); }
+
+namespace {
+
+using namespace std::chrono_literals;
+
+using Payload = std::vector<std::uint8_t>;
+
+using EventDispatcher = dear::apd::skeleton::EventDispatcher<Payload>;
+using Event = dear::apd::proxy::Event<Payload>;
+
+using SkeletonEvent = dear::SkeletonEventTransactor<EventDispatcher>;
+using ProxyEvent = dear::ProxyEventTransactor<Event&>;
+
+namespace sim = ara::com::internal::sim;
+
+struct Config {
+  std::size_t topics{1000};
+  reactor::Duration period{10ms};
+  reactor::Duration duration{5s};
+  unsigned workers{4};
+  std::size_t payload_size{64};
+
+  reactor::Duration deadline{1ms};
+  reactor::Duration max_network_delay{1ms};
+  reactor::Duration max_synchronization_error{1ms};
+
+  // Latency of all links. The exponential tail lets a small share of the
+  // events exceed the delay bound, which are dropped as timing violations
+  // unless the clock skew of the link makes up for it.
+  reactor::Duration min_latency{200us};
+  reactor::Duration mean_queueing{200us};
+  reactor::Duration jitter{50us};
+  double loss{0.001};
+
+  // interval at which the network is advanced in virtual time
+  reactor::Duration step{100us};
+};
+
+std::atomic<std::uint64_t> received_events{0};
+dear::LatencyHistogram receive_lag;
+
+// The sending half of a topic. Periodically sends an event via its skeleton
+// transactor. The publishers of all topics are spread evenly over the period.
+class Publisher : public reactor::Reactor {
+ private:
+  EventDispatcher dispatcher;
+
+  reactor::ImmutableValuePtr<Payload> payload;
+
+  reactor::Timer timer;
+
+  SkeletonEvent skeleton;
+
+  // reactions
+  reactor::Reaction r_timer{"r_timer", 1, this,
+                            [this]() { skeleton.notify.set(payload); }};
+
+ public:
+  Publisher(const std::string& name,
+            reactor::Environment* env,
+            const Config& config,
+            reactor::Duration offset)
+      : reactor::Reactor(name, env)
+      , payload(reactor::make_immutable_value<Payload>(config.payload_size,
+                                                        0xab))
+      , timer("timer", this, config.period, offset)
+      , skeleton("skeleton", this, &dispatcher, config.deadline) {}
+
+  EventDispatcher& event_dispatcher() { return dispatcher; }
+
+  void assemble() override {
+    r_timer.declare_trigger(&timer);
+    r_timer.declare_antidependency(&skeleton.notify);
+  }
+};
+
+// The receiving half of a topic. Counts the events released by its proxy
+// transactor and records how far their release lags behind physical time.
+class Subscriber : public reactor::Reactor {
+ private:
+  ProxyEvent proxy;
+
+  // reactions
+  reactor::Reaction r_receive{"r_receive", 1, this, [this]() { on_receive(); }};
+
+  // reaction bodies
+  void on_receive() {
+    receive_lag.record(reactor::get_physical_time() - get_logical_time());
+    received_events.fetch_add(1, std::memory_order_relaxed);
+  }
+
+ public:
+  Subscriber(const std::string& name,
+             reactor::Environment* env,
+             const Config& config)
+      : reactor::Reactor(name, env)
+      , proxy("proxy",
+              this,
+              config.max_network_delay,
+              config.max_synchronization_error) {}
+
+  // Hands a sample to the proxy transactor. Called by the network.
+  void inject(const reactor::TimePoint& timestamp, const Payload& sample) {
+    proxy.inject(timestamp, reactor::make_immutable_value<Payload>(sample));
+  }
+
+  void assemble() override { r_receive.declare_trigger(&proxy.notify); }
+};
+
+// Advances the network along with the logical time of the senders. At each
+// tag, all messages sent at earlier tags were handed to the network. As no
+// message arrives before its timestamp, this includes all messages that
+// arrive before the current tag.
+class Pacer : public reactor::Reactor {
+ private:
+  sim::Network& network;
+  reactor::Timer timer;
+  reactor::Reaction r_step{"r_step", 1, this,
+                           [this]() { network.run_until(get_logical_time()); }};
+
+ public:
+  Pacer(const std::string& name,
+        reactor::Environment* env,
+        sim::Network& network,
+        reactor::Duration step)
+      : reactor::Reactor(name, env)
+      , network(network)
+      , timer("timer", this, step) {}
+
+  void assemble() override { r_step.declare_trigger(&timer); }
+};
+
+// Shuts down the environment after the configured duration.
+class Stopper : public reactor::Reactor {
+ private:
+  reactor::Timer timer;
+  reactor::Reaction r_stop{"r_stop", 1, this,
+                           [this]() { environment()->sync_shutdown(); }};
+
+ public:
+  Stopper(const std::string& name,
+          reactor::Environment* env,
+          reactor::Duration duration)
+      : reactor::Reactor(name, env), timer("timer", this, duration, duration) {}
+
+  void assemble() override { r_stop.declare_trigger(&timer); }
+};
+
+// Shuts down the environment of the receivers once the messages injected so
+// far were released.
+class Drain : public reactor::Reactor {
+ private:
+  reactor::PhysicalAction<void> stop{"stop", this};
+  reactor::Reaction r_stop{"r_stop", 1, this,
+                           [this]() { environment()->sync_shutdown(); }};
+
+ public:
+  Drain(const std::string& name, reactor::Environment* env)
+      : reactor::Reactor(name, env) {}
+
+  // May be called from any thread. No message is released later than the
+  // given delay after its injection.
+  void shutdown_after(reactor::Duration delay) { stop.schedule(delay); }
+
+  void assemble() override { r_stop.declare_trigger(&stop); }
+};
+
+void run(const Config& config) {
+  sim::Network network{42};
+  std::mt19937_64 rng{42};
+  std::uniform_int_distribution<reactor::Duration::rep> skew{
+      -config.max_synchronization_error.count(),
+      config.max_synchronization_error.count()};
+
+  sim::LinkModel model;
+  model.latency =
+      sim::exponential_latency(config.min_latency, config.mean_queueing);
+  model.jitter = config.jitter;
+  model.loss = config.loss;
+
+  // The senders do not wait for physical time. The receivers have no events
+  // of their own until the first message arrives.
+  reactor::Environment sender_env{config.workers, false, true};
+  reactor::Environment receiver_env{config.workers, true};
+  Stopper stopper{"stopper", &sender_env, config.duration};
+  Pacer pacer{"pacer", &sender_env, network, config.step};
+  Drain drain{"drain", &receiver_env};
+
+  auto memory_before = live_bytes.load();
+  std::vector<std::unique_ptr<Publisher>> publishers;
+  std::vector<std::unique_ptr<Subscriber>> subscribers;
+  publishers.reserve(config.topics);
+  subscribers.reserve(config.topics);
+  for (std::size_t i = 0; i < config.topics; i++) {
+    model.clock_skew = reactor::Duration{skew(rng)};
+    auto offset = 10ms + config.period * i / config.topics;
+    publishers.push_back(std::make_unique<Publisher>(
+        "publisher_" + std::to_string(i), &sender_env, config, offset));
+    subscribers.push_back(std::make_unique<Subscriber>(
+        "subscriber_" + std::to_string(i), &receiver_env, config));
+
+    auto subscriber = subscribers.back().get();
+    publishers.back()->event_dispatcher().Connect(
+        [&network, subscriber](ara::com::SamplePtr<const Payload> sample,
+                               const reactor::TimePoint& timestamp) {
+          // move the timestamp from virtual time to the physical clock of
+          // the receivers, keeping its distance to the arrival time
+          subscriber->inject(
+              timestamp - network.now() + reactor::get_physical_time(),
+              *sample);
+        },
+        network.add_link(model));
+  }
+  sender_env.assemble();
+  receiver_env.assemble();
+  auto memory_per_topic =
+      static_cast<double>(live_bytes.load() - memory_before) /
+      static_cast<double>(config.topics);
+
+  auto start = reactor::get_physical_time();
+  auto receiver_thread = receiver_env.startup();
+  auto sender_thread = sender_env.startup();
+  sender_thread.join();
+  // deliver the messages that are still in flight
+  network.run();
+  drain.shutdown_after(config.max_network_delay +
+                       2 * config.max_synchronization_error);
+  receiver_thread.join();
+  std::chrono::duration<double> elapsed = reactor::get_physical_time() - start;
+
+  std::uint64_t sent = 0;
+  for (const auto& snapshot : dear::collect_metrics(&sender_env)) {
+    sent += snapshot.messages_sent;
+  }
+  std::uint64_t violations = 0;
+  for (const auto& snapshot : dear::collect_metrics(&receiver_env)) {
+    violations += snapshot.timing_violations;
+  }
+
+  auto received = received_events.load();
+  std::chrono::duration<double, std::micro> lag =
+      receive_lag.value_at_percentile(99.0);
+  std::chrono::duration<double> simulated = config.duration;
+  std::printf("%8zu %10" PRIu64 " %10" PRIu64 " %10" PRIu64 " %8" PRIu64
+              " %8" PRIu64 " %11.1f %12.1f %8.1f %11.2f %11.2f\n",
+              config.topics, sent, network.delivered(), received,
+              network.lost(), violations, lag.count(),
+              static_cast<double>(received) / elapsed.count(),
+              simulated.count() / elapsed.count(),
+              100.0 * static_cast<double>(violations) /
+                  static_cast<double>(std::max<std::uint64_t>(
+                      network.delivered(), 1)),
+              memory_per_topic / 1024.0);
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  Config config;
+  if (argc > 1) {
+    config.topics = std::stoul(argv[1]);
+  }
+  if (argc > 2) {
+    config.period = std::chrono::milliseconds{std::stoul(argv[2])};
+  }
+  if (argc > 3) {
+    config.duration = std::chrono::milliseconds{std::stoul(argv[3])};
+  }
+  if (argc > 4) {
+    config.workers = static_cast<unsigned>(std::stoul(argv[4]));
+  }
+
+  std::printf("%8s %10s %10s %10s %8s %8s %11s %12s %8s %11s %11s\n",
+              "topics", "sent", "delivered", "received", "lost", "late",
+              "lag p99[us]", "events/s", "speedup", "late[%]", "KiB/topic");
+  run(config);
+  return 0;
+}
@@ -0,0 +1,956 @@
+/*
+ * Copyright (C) 2020 TU Dresden
+ * All rights reserved.
+ *
+ * Authors:
+ *   Christian Menard
+ */
+
+// Measures the overhead of the DEAR transactors on top of the in-process APD
+// mock. For each payload size, messages are sent periodically through a
+// SkeletonEventTransactor/ProxyEventTransactor pair (copying, sharing, and
+// decoding samples on a worker pool) and through a
+// ProxyMethodTransactor/SkeletonMethodTransactor pair (echo service).
+//
+// Reported are the achieved throughput, the lag between the release tag and
+// the physical time at which the message is processed by the receiving
+// reaction (p50/p99/p999), the number of messages lost to timing violations,
+// and the number of heap allocations per message.
+//
+// For the method pair, the allocations made by
+// SkeletonMethodTransactor::process_request() on the binding's thread are
+// reported separately. The benchmark fails if the request pool of the
+// skeleton had to fall back to the heap.
+//
+// Finally, a few short runs check that the optional features of the
+// transactors deliver all messages, or the ones they promise, in order. The
+// benchmark fails if one of these checks fails.
+//
+// Usage: transactor_benchmark [messages] [period_us] [workers]
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <new>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <reactor-cpp/reactor-cpp.hh>
+
+#include "dear/shm_event_transactor.hh"
+#include "dear/skeleton_event_group.hh"
+#include "dear/trace_replay.hh"
+#include "dear/transactor.hh"
+#include "dear/vsomeip_time.hh"
+
+namespace {
+
+std::atomic<std::size_t> allocation_count{0};
+thread_local std::size_t thread_allocation_count{0};
+
+}  // namespace
+
+void* operator new(std::size_t size) {
+  allocation_count.fetch_add(1, std::memory_order_relaxed);
+  thread_allocation_count++;
+  void* p = std::malloc(size == 0 ? 1 : size);
+  if (p == nullptr) {
+    throw std::bad_alloc();
+  }
+  return p;
+}
+
+void* operator new[](std::size_t size) { return operator new(size); }
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete[](void* p) noexcept { std::free(p); }
+void operator delete(void* p, std::size_t) noexcept { std::free(p); }
+void operator delete[](void* p, std::size_t) noexcept { std::free(p); }
+
+namespace {
+
+using namespace std::chrono_literals;
+
+using Payload = std::vector<std::uint8_t>;
+
+struct EchoService {
+  dear::apd::Future<Payload> Echo(const Payload& payload);
+};
+
+using EventDispatcher = dear::apd::skeleton::EventDispatcher<Payload>;
+using Event = dear::apd::proxy::Event<Payload>;
+using Method = dear::apd::proxy::Method<Payload(Payload)>;
+
+using SkeletonEvent = dear::SkeletonEventTransactor<EventDispatcher>;
+using ProxyEvent = dear::ProxyEventTransactor<Event&>;
+using ProxyMethod = dear::ProxyMethodTransactor<Method>;
+using SkeletonMethod =
+    dear::SkeletonMethodTransactor<decltype(&EchoService::Echo)>;
+using ShmSkeletonEvent = dear::ShmSkeletonEventTransactor<Payload>;
+using ShmProxyEvent = dear::ShmProxyEventTransactor<Payload>;
+
+struct Config {
+  std::size_t messages{10000};
+  reactor::Duration period{100us};
+  unsigned workers{4};
+
+  // all messages are released 3ms after they were sent
+  reactor::Duration deadline{1ms};
+  reactor::Duration max_network_delay{1ms};
+  reactor::Duration max_synchronization_error{1ms};
+
+  // number of messages sent by each functional check
+  std::size_t check_messages{1000};
+};
+
+// Records the lag between the release tag and the physical time of all
+// received messages and shuts down the environment once all messages were
+// received or a timeout expired.
+class Recorder {
+ private:
+  std::size_t expected;
+  std::size_t allocations_at_start{0};
+  std::size_t allocations_at_end{0};
+  reactor::TimePoint first_receive;
+  reactor::TimePoint last_receive;
+
+ public:
+  std::vector<reactor::Duration> lags;
+
+  explicit Recorder(std::size_t expected) : expected(expected) {
+    lags.reserve(expected);
+  }
+
+  void start() {
+    allocations_at_start = allocation_count.load(std::memory_order_relaxed);
+  }
+
+  // returns true if all messages were received
+  bool record(reactor::TimePoint logical_time) {
+    auto now = reactor::Reactor::get_physical_time();
+    if (lags.empty()) {
+      first_receive = now;
+    }
+    last_receive = now;
+    lags.push_back(now - logical_time);
+    if (lags.size() == expected) {
+      allocations_at_end = allocation_count.load(std::memory_order_relaxed);
+      return true;
+    }
+    return false;
+  }
+
+  void stop() {
+    if (allocations_at_end == 0) {
+      allocations_at_end = allocation_count.load(std::memory_order_relaxed);
+    }
+  }
+
+  double throughput() const {
+    if (lags.size() < 2) {
+      return 0.0;
+    }
+    std::chrono::duration<double> elapsed = last_receive - first_receive;
+    return static_cast<double>(lags.size() - 1) / elapsed.count();
+  }
+
+  double allocations_per_message() const {
+    return static_cast<double>(allocations_at_end - allocations_at_start) /
+           static_cast<double>(std::max<std::size_t>(lags.size(), 1));
+  }
+};
+
+// Binds a transactor at startup or after the given delay.
+template <class B>
+class Binder : public reactor::Reactor {
+ private:
+  B* binding;
+  reactor::Duration delay;
+
+  reactor::StartupAction startup{"startup", this};
+  reactor::LogicalAction<void> bind{"bind", this};
+  reactor::Reaction r_startup{"r_startup", 1, this, [this]() { on_startup(); }};
+  reactor::Reaction r_bind{"r_bind", 2, this, [this]() { out.set(binding); }};
+
+  void on_startup() {
+    if (delay == reactor::Duration::zero()) {
+      out.set(binding);
+    } else {
+      bind.schedule(delay);
+    }
+  }
+
+ public:
+  reactor::Output<B*> out{"out", this};
+
+  Binder(const std::string& name,
+         reactor::Environment* env,
+         B* binding,
+         reactor::Duration delay = reactor::Duration::zero())
+      : reactor::Reactor(name, env), binding(binding), delay(delay) {}
+
+  void assemble() override {
+    r_startup.declare_trigger(&startup);
+    r_startup.declare_antidependency(&out);
+    r_startup.declare_scheduable_action(&bind);
+    r_bind.declare_trigger(&bind);
+    r_bind.declare_antidependency(&out);
+  }
+};
+
+// Sends the same payload periodically. Reusing the payload keeps its
+// allocation out of the measurement.
+class Source : public reactor::Reactor {
+ private:
+  reactor::ImmutableValuePtr<Payload> payload;
+  std::size_t remaining;
+  Recorder& recorder;
+  reactor::Duration timeout;
+
+  reactor::Timer timer;
+  reactor::LogicalAction<void> stop{"stop", this};
+
+  reactor::Reaction r_timer{"r_timer", 1, this, [this]() { on_timer(); }};
+  reactor::Reaction r_stop{"r_stop", 2, this, [this]() { on_stop(); }};
+
+  void on_timer() {
+    if (remaining == 0) {
+      return;
+    }
+    if (get_elapsed_logical_time() == timer_offset()) {
+      recorder.start();
+    }
+    out.set(payload);
+    if (--remaining == 0) {
+      stop.schedule(timeout);
+    }
+  }
+
+  void on_stop() {
+    recorder.stop();
+    environment()->sync_shutdown();
+  }
+
+  static reactor::Duration timer_offset() { return 10ms; }
+
+ public:
+  reactor::Output<Payload> out{"out", this};
+
+  Source(const std::string& name,
+         reactor::Environment* env,
+         const Config& config,
+         std::size_t payload_size,
+         Recorder& recorder)
+      : reactor::Reactor(name, env)
+      , payload(reactor::make_immutable_value<Payload>(payload_size, 0xab))
+      , remaining(config.messages)
+      , recorder(recorder)
+      , timeout(config.deadline + config.max_network_delay +
+                config.max_synchronization_error + 100ms)
+      , timer("timer", this, config.period, timer_offset()) {}
+
+  void assemble() override {
+    r_timer.declare_trigger(&timer);
+    r_timer.declare_antidependency(&out);
+    r_timer.declare_scheduable_action(&stop);
+    r_stop.declare_trigger(&stop);
+  }
+};
+
+template <class T>
+class Sink : public reactor::Reactor {
+ private:
+  Recorder& recorder;
+
+  reactor::Reaction r_in{"r_in", 1, this, [this]() { on_in(); }};
+
+  void on_in() {
+    if (recorder.record(get_logical_time())) {
+      recorder.stop();
+      environment()->sync_shutdown();
+    }
+  }
+
+ public:
+  reactor::Input<T> in{"in", this};
+
+  Sink(const std::string& name, reactor::Environment* env, Recorder& recorder)
+      : reactor::Reactor(name, env), recorder(recorder) {}
+
+  void assemble() override { r_in.declare_trigger(&in); }
+};
+
+class Echo : public reactor::Reactor {
+ private:
+  reactor::Reaction r_request{"r_request", 1, this,
+                              [this]() { response.set(request.get()); }};
+
+ public:
+  reactor::Input<Payload> request{"request", this};
+  reactor::Output<Payload> response{"response", this};
+
+  Echo(const std::string& name, reactor::Environment* env)
+      : reactor::Reactor(name, env) {}
+
+  void assemble() override {
+    r_request.declare_trigger(&request);
+    r_request.declare_antidependency(&response);
+  }
+};
+
+// Functional checks send payloads that carry a sequence number, so that the
+// receiver can tell which messages arrived and in which order.
+Payload sequence_payload(std::uint64_t sequence) {
+  Payload payload(sizeof(sequence));
+  std::memcpy(payload.data(), &sequence, sizeof(sequence));
+  return payload;
+}
+
+std::uint64_t sequence_number(const Payload& payload) {
+  std::uint64_t sequence = 0;
+  std::memcpy(&sequence, payload.data(),
+              std::min(payload.size(), sizeof(sequence)));
+  return sequence;
+}
+
+// Sends the given number of numbered payloads periodically and shuts down
+// the environment once the last one had time to arrive.
+class SequenceSource : public reactor::Reactor {
+ private:
+  const std::size_t count;
+  std::uint64_t next{0};
+  reactor::Duration timeout;
+
+  reactor::Timer timer;
+  reactor::LogicalAction<void> stop{"stop", this};
+
+  reactor::Reaction r_timer{"r_timer", 1, this, [this]() { on_timer(); }};
+  reactor::Reaction r_stop{"r_stop", 2, this,
+                           [this]() { environment()->sync_shutdown(); }};
+
+  void on_timer() {
+    if (next == count) {
+      return;
+    }
+    out.set(sequence_payload(next++));
+    if (next == count) {
+      stop.schedule(timeout);
+    }
+  }
+
+ public:
+  reactor::Output<Payload> out{"out", this};
+
+  SequenceSource(const std::string& name,
+                 reactor::Environment* env,
+                 const Config& config)
+      : reactor::Reactor(name, env)
+      , count(config.check_messages)
+      , timeout(config.deadline + config.max_network_delay +
+                config.max_synchronization_error + 100ms)
+      , timer("timer", this, config.period, 10ms) {}
+
+  void assemble() override {
+    r_timer.declare_trigger(&timer);
+    r_timer.declare_antidependency(&out);
+    r_timer.declare_scheduable_action(&stop);
+    r_stop.declare_trigger(&stop);
+  }
+};
+
+// Collects the sequence numbers of all received payloads, either received
+// one by one or as a batch.
+class SequenceSink : public reactor::Reactor {
+ private:
+  std::vector<std::uint64_t>& received;
+
+  reactor::Reaction r_in{"r_in", 1, this, [this]() {
+                           received.push_back(sequence_number(*in.get()));
+                         }};
+  reactor::Reaction r_batch{"r_batch", 2, this, [this]() { on_batch(); }};
+
+  void on_batch() {
+    for (const auto& payload : *batch.get()) {
+      received.push_back(sequence_number(payload));
+    }
+  }
+
+ public:
+  reactor::Input<Payload> in{"in", this};
+  reactor::Input<std::vector<Payload>> batch{"batch", this};
+
+  SequenceSink(const std::string& name,
+               reactor::Environment* env,
+               std::vector<std::uint64_t>& received)
+      : reactor::Reactor(name, env), received(received) {}
+
+  void assemble() override {
+    r_in.declare_trigger(&in);
+    r_batch.declare_trigger(&batch);
+  }
+};
+
+// Shuts down the environment once stop() is called from outside of it.
+class Stopper : public reactor::Reactor {
+ private:
+  reactor::PhysicalAction<void> action{"action", this};
+
+  reactor::Reaction r_action{"r_action", 1, this,
+                             [this]() { environment()->sync_shutdown(); }};
+
+ public:
+  Stopper(const std::string& name, reactor::Environment* env)
+      : reactor::Reactor(name, env) {}
+
+  void stop() { action.schedule(); }
+
+  void assemble() override { r_action.declare_trigger(&action); }
+};
+
+// Collects the values set on a backpressure port.
+class BackpressureMonitor : public reactor::Reactor {
+ private:
+  std::vector<bool>& values;
+
+  reactor::Reaction r_in{"r_in", 1, this,
+                         [this]() { values.push_back(*in.get()); }};
+
+ public:
+  reactor::Input<bool> in{"in", this};
+
+  BackpressureMonitor(const std::string& name,
+                      reactor::Environment* env,
+                      std::vector<bool>& values)
+      : reactor::Reactor(name, env), values(values) {}
+
+  void assemble() override { r_in.declare_trigger(&in); }
+};
+
+// Prints the result of a functional check. If complete is set, all sent
+// messages need to be received, otherwise at least the last one. In both
+// cases, they need to arrive in the order they were sent. Returns true if
+// the check passed.
+bool report_check(const char* check,
+                  std::size_t sent,
+                  const std::vector<std::uint64_t>& received,
+                  bool complete = true) {
+  bool in_order =
+      std::adjacent_find(received.begin(), received.end(),
+                         [](auto a, auto b) { return a >= b; }) ==
+      received.end();
+  bool delivered = complete ? received.size() == sent
+                            : !received.empty() && received.back() == sent - 1;
+  bool passed = in_order && delivered;
+  std::printf("%-12s %9zu %9zu %9s %7s\n", check, sent, received.size(),
+              in_order ? "yes" : "no", passed ? "ok" : "FAIL");
+  return passed;
+}
+
+void run_event_benchmark(const Config& config,
+                         std::size_t payload_size,
+                         const dear::ProxyEventOptions& options,
+                         Recorder& recorder) {
+  EventDispatcher dispatcher;
+  Event event;
+  dispatcher.Connect(&event);
+
+  reactor::Environment env{config.workers};
+  Source source{"source", &env, config, payload_size, recorder};
+  SkeletonEvent skeleton{"skeleton", &env, &dispatcher, config.deadline};
+  Binder<Event> binder{"binder", &env, &event};
+  ProxyEvent proxy{"proxy", &env, config.max_network_delay,
+                   config.max_synchronization_error, options};
+  Sink<Payload> sink{"sink", &env, recorder};
+  Sink<ProxyEvent::SamplePtr> shared_sink{"shared_sink", &env, recorder};
+
+  source.out.bind_to(&skeleton.notify);
+  binder.out.bind_to(&proxy.update_binding);
+  proxy.notify.bind_to(&sink.in);
+  proxy.notify_shared.bind_to(&shared_sink.in);
+
+  env.assemble();
+  auto thread = env.startup();
+  thread.join();
+}
+
+void run_shm_event_benchmark(const Config& config,
+                             std::size_t payload_size,
+                             Recorder& recorder) {
+  const std::string channel_name{"/dear_transactor_benchmark"};
+  dear::ShmChannel::remove(channel_name);
+  dear::ShmChannelOptions channel_options;
+  channel_options.slot_size = payload_size;
+  channel_options.capacity = 64;
+
+  reactor::Environment env{config.workers};
+  Source source{"source", &env, config, payload_size, recorder};
+  ShmProxyEvent proxy{"proxy",
+                      &env,
+                      channel_name,
+                      config.max_network_delay,
+                      config.max_synchronization_error,
+                      channel_options};
+  ShmSkeletonEvent skeleton{"skeleton", &env, channel_name, config.deadline,
+                            channel_options};
+  Sink<Payload> sink{"sink", &env, recorder};
+
+  source.out.bind_to(&skeleton.notify);
+  proxy.notify.bind_to(&sink.in);
+
+  env.assemble();
+  auto thread = env.startup();
+  thread.join();
+  dear::ShmChannel::remove(channel_name);
+}
+
+// allocations made by the skeleton while accepting requests
+struct RequestAllocations {
+  std::atomic<std::size_t> requests{0};
+  std::atomic<std::size_t> allocations{0};
+  std::size_t pool_heap_allocations{0};
+
+  double per_request() const {
+    return static_cast<double>(allocations.load()) /
+           static_cast<double>(std::max<std::size_t>(requests.load(), 1));
+  }
+};
+
+void run_method_benchmark(const Config& config,
+                          std::size_t payload_size,
+                          Recorder& recorder,
+                          RequestAllocations& request_allocations) {
+  Method method;
+
+  reactor::Environment env{config.workers};
+  Source source{"source", &env, config, payload_size, recorder};
+  Binder<Method> binder{"binder", &env, &method};
+  // a round trip takes about 6ms, so many calls are in flight at once
+  dear::ProxyMethodOptions options;
+  options.max_in_flight = 256;
+  options.response_timeout = 2 * (config.deadline + config.max_network_delay +
+                                  config.max_synchronization_error) +
+                             10ms;
+  ProxyMethod proxy{"proxy",
+                    &env,
+                    config.deadline,
+                    config.max_network_delay,
+                    config.max_synchronization_error,
+                    options};
+  SkeletonMethod skeleton{"skeleton", &env, config.deadline,
+                          config.max_network_delay,
+                          config.max_synchronization_error};
+  Echo echo{"echo", &env};
+  Sink<Payload> sink{"sink", &env, recorder};
+
+  method.Bind([&skeleton, &request_allocations](const Payload& payload) {
+    auto before = thread_allocation_count;
+    auto future = skeleton.process_request(payload);
+    request_allocations.allocations.fetch_add(
+        thread_allocation_count - before, std::memory_order_relaxed);
+    request_allocations.requests.fetch_add(1, std::memory_order_relaxed);
+    return future;
+  });
+
+  source.out.bind_to(&proxy.request);
+  binder.out.bind_to(&proxy.update_binding);
+  skeleton.request.bind_to(&echo.request);
+  echo.response.bind_to(&skeleton.response);
+  proxy.response.bind_to(&sink.in);
+
+  env.assemble();
+  auto thread = env.startup();
+  thread.join();
+  request_allocations.pool_heap_allocations =
+      skeleton.request_pool_heap_allocations();
+}
+
+// Sends numbered events through a SkeletonEventTransactor/ProxyEventTransactor
+// pair with the given options and returns the sequence numbers in the order
+// they were received. If trace is set, the proxy records to it.
+std::vector<std::uint64_t> run_event_check(
+    const Config& config,
+    const dear::ProxyEventOptions& options,
+    dear::TraceWriter* trace = nullptr) {
+  EventDispatcher dispatcher;
+  Event event;
+  dispatcher.Connect(&event);
+  std::vector<std::uint64_t> received;
+
+  reactor::Environment env{config.workers};
+  SequenceSource source{"source", &env, config};
+  SkeletonEvent skeleton{"skeleton", &env, &dispatcher, config.deadline};
+  Binder<Event> binder{"binder", &env, &event};
+  ProxyEvent proxy{"proxy", &env, config.max_network_delay,
+                   config.max_synchronization_error, options};
+  SequenceSink sink{"sink", &env, received};
+
+  source.out.bind_to(&skeleton.notify);
+  binder.out.bind_to(&proxy.update_binding);
+  proxy.notify.bind_to(&sink.in);
+  proxy.notify_batch.bind_to(&sink.batch);
+  if (trace != nullptr) {
+    proxy.record_to(trace);
+  }
+
+  env.assemble();
+  auto thread = env.startup();
+  thread.join();
+  return received;
+}
+
+// Delivers samples that map to the same release tag as one batch.
+bool check_batch_samples(const Config& config) {
+  dear::ProxyEventOptions options;
+  options.batch_samples = true;
+  return report_check("batch", config.check_messages,
+                      run_event_check(config, options));
+}
+
+// Keeps only the newest sample of each burst. Samples may be skipped, but
+// the last one must arrive and none may arrive out of order.
+bool check_latest_only(const Config& config) {
+  return report_check("latest_only", config.check_messages,
+                      run_event_check(config,
+                                      dear::ProxyEventOptions::latest_only()),
+                      false);
+}
+
+// Issues calls before the proxy is bound to the service method. The proxy
+// buffers them and sends them once it is bound, which happens before their
+// deadline expired. All responses must arrive in order.
+bool check_unbound_requests(const Config& config) {
+  Method method;
+  std::vector<std::uint64_t> received;
+
+  reactor::Environment env{config.workers};
+  SequenceSource source{"source", &env, config};
+  // The source starts at 10ms, so the requests of the first half deadline
+  // are buffered.
+  Binder<Method> binder{"binder", &env, &method, 10ms + config.deadline / 2};
+  dear::ProxyMethodOptions options;
+  options.max_unbound_requests = config.check_messages;
+  options.response_timeout = 2 * (config.deadline + config.max_network_delay +
+                                  config.max_synchronization_error) +
+                             10ms;
+  ProxyMethod proxy{"proxy",
+                    &env,
+                    config.deadline,
+                    config.max_network_delay,
+                    config.max_synchronization_error,
+                    options};
+  SkeletonMethod skeleton{"skeleton", &env, config.deadline,
+                          config.max_network_delay,
+                          config.max_synchronization_error};
+  Echo echo{"echo", &env};
+  SequenceSink sink{"sink", &env, received};
+
+  method.Bind([&skeleton](const Payload& payload) {
+    return skeleton.process_request(payload);
+  });
+
+  source.out.bind_to(&proxy.request);
+  binder.out.bind_to(&proxy.update_binding);
+  skeleton.request.bind_to(&echo.request);
+  echo.response.bind_to(&skeleton.response);
+  proxy.response.bind_to(&sink.in);
+
+  env.assemble();
+  auto thread = env.startup();
+  thread.join();
+  return report_check("unbound", config.check_messages, received);
+}
+
+// Sends events via the outbound queue of a skeleton transactor to a receiver
+// that takes three periods per event, so that the queue overflows. Every
+// event that was not dropped must arrive in order, and backpressure must be
+// raised and relieved again once the queue drained.
+bool check_send_queue(const Config& config) {
+  EventDispatcher dispatcher;
+  std::vector<std::uint64_t> received;
+  std::vector<bool> backpressure;
+  auto processing_time = 3 * config.period;
+  // invoked on the sender thread of the skeleton transactor
+  dispatcher.Connect([&received, processing_time](
+                         auto sample, const reactor::TimePoint&) {
+    received.push_back(sequence_number(*sample));
+    std::this_thread::sleep_for(processing_time);
+  });
+
+  dear::SkeletonEventOptions options;
+  options.queue_depth = 8;
+  options.policy = dear::SendQueuePolicy::kDropNewest;
+
+  reactor::Environment env{config.workers};
+  SequenceSource source{"source", &env, config};
+  SkeletonEvent skeleton{"skeleton", &env, &dispatcher, config.deadline,
+                         options};
+  BackpressureMonitor monitor{"monitor", &env, backpressure};
+
+  source.out.bind_to(&skeleton.notify);
+  skeleton.backpressure.bind_to(&monitor.in);
+
+  env.assemble();
+  auto thread = env.startup();
+  thread.join();
+
+  auto dropped = skeleton.metrics().dropped_messages.load();
+  bool passed =
+      report_check("queue", config.check_messages - dropped, received);
+  bool relieved =
+      !backpressure.empty() && backpressure.front() && !backpressure.back();
+  if (!relieved) {
+    std::printf("%-12s backpressure was not raised and relieved\n", "queue");
+  }
+  return passed && relieved;
+}
+
+// Records the events received by a proxy and replays them as fast as
+// possible into an unbound proxy of the same name. All recorded events must
+// arrive again in order.
+bool check_replay(const Config& config) {
+  const std::string path{"transactor_benchmark.trace"};
+  {
+    dear::TraceWriter trace{path};
+    run_event_check(config, {}, &trace);
+  }
+
+  std::vector<std::uint64_t> received;
+  {
+    dear::TraceReplay replay{path};
+    // runs until the stopper is triggered, as events only enter via replay
+    reactor::Environment env{config.workers, true};
+    ProxyEvent proxy{"proxy", &env, config.max_network_delay,
+                     config.max_synchronization_error};
+    SequenceSink sink{"sink", &env, received};
+    Stopper stopper{"stopper", &env};
+
+    proxy.notify.bind_to(&sink.in);
+
+    replay.attach(proxy);
+    env.assemble();
+    auto thread = env.startup();
+    replay.run(dear::ReplayPace::kAsFastAsPossible);
+    // The events keep their original spacing in logical time. Wait until
+    // the last one was released.
+    auto duration =
+        static_cast<reactor::Duration::rep>(config.check_messages) *
+        config.period;
+    std::this_thread::sleep_for(duration + config.deadline +
+                                config.max_network_delay +
+                                config.max_synchronization_error + 100ms);
+    stopper.stop();
+    thread.join();
+  }
+  std::remove(path.c_str());
+
+  return report_check("replay", config.check_messages, received);
+}
+
+// Sends the events of several skeleton transactors via a group and checks
+// that each proxy receives all of them in order.
+bool check_event_group(const Config& config) {
+  constexpr std::size_t kMembers = 3;
+  std::vector<std::unique_ptr<EventDispatcher>> dispatchers;
+  std::vector<std::unique_ptr<Event>> events;
+  for (std::size_t i = 0; i < kMembers; i++) {
+    dispatchers.push_back(std::make_unique<EventDispatcher>());
+    events.push_back(std::make_unique<Event>());
+    dispatchers.back()->Connect(events.back().get());
+  }
+
+  reactor::Environment env{config.workers};
+  SequenceSource source{"source", &env, config};
+  dear::SkeletonEventGroup group{"group", &env, config.deadline};
+  std::vector<std::unique_ptr<SkeletonEvent>> skeletons;
+  std::vector<std::unique_ptr<Binder<Event>>> binders;
+  std::vector<std::unique_ptr<ProxyEvent>> proxies;
+  std::vector<std::unique_ptr<SequenceSink>> sinks;
+  std::vector<std::vector<std::uint64_t>> received(kMembers);
+  for (std::size_t i = 0; i < kMembers; i++) {
+    auto index = std::to_string(i);
+    skeletons.push_back(std::make_unique<SkeletonEvent>(
+        "skeleton_" + index, &env, dispatchers[i].get(), config.deadline));
+    skeletons.back()->join(&group);
+    binders.push_back(std::make_unique<Binder<Event>>("binder_" + index, &env,
+                                                      events[i].get()));
+    proxies.push_back(std::make_unique<ProxyEvent>(
+        "proxy_" + index, &env, config.max_network_delay,
+        config.max_synchronization_error));
+    sinks.push_back(
+        std::make_unique<SequenceSink>("sink_" + index, &env, received[i]));
+
+    source.out.bind_to(&skeletons.back()->notify);
+    binders.back()->out.bind_to(&proxies.back()->update_binding);
+    proxies.back()->notify.bind_to(&sinks.back()->in);
+  }
+
+  env.assemble();
+  auto thread = env.startup();
+  thread.join();
+
+  bool passed = true;
+  for (std::size_t i = 0; i < kMembers; i++) {
+    auto name = "group/" + std::to_string(i);
+    passed &= report_check(name.c_str(), config.check_messages, received[i]);
+  }
+  return passed;
+}
+
+// Appends the timestamp trailer to payloads with arguments of varying size
+// and reads the timestamps back. The row "legacy" checks that payloads in
+// the legacy format, whose last four bytes equal the magic word of the
+// trailer, are not taken for a trailer. A payload counts as received if its
+// timestamp was read correctly or it was rejected, respectively.
+bool check_timestamp_trailer(const Config& config) {
+  std::vector<std::uint64_t> read;
+  std::vector<std::uint64_t> rejected;
+  for (std::uint64_t i = 0; i < config.check_messages; i++) {
+    std::vector<::vsomeip::byte_t> arguments(i % 37, 0);
+
+    auto data = arguments;
+    reactor::TimePoint timestamp{reactor::Duration{i * 1000003}};
+    dear::append_timestamp_trailer(data, timestamp);
+    ::vsomeip::payload payload{std::move(data)};
+    auto result = dear::get_timestamp_from_trailer(payload);
+    if (result.HasValue() && result.Value() == timestamp) {
+      read.push_back(i);
+    }
+
+    // the legacy format appends the bare timestamp in big endian
+    data = arguments;
+    auto legacy_ns = static_cast<std::int64_t>(i << 32 | dear::trailer::kMagic);
+    for (int shift = 56; shift >= 0; shift -= 8) {
+      data.push_back(static_cast<::vsomeip::byte_t>(legacy_ns >> shift));
+    }
+    payload.set_data(std::move(data));
+    if (!dear::get_timestamp_from_trailer(payload).HasValue()) {
+      rejected.push_back(i);
+    }
+  }
+  bool passed = report_check("trailer", config.check_messages, read);
+  passed &= report_check("legacy", config.check_messages, rejected);
+  return passed;
+}
+
+double to_us(reactor::Duration d) {
+  return std::chrono::duration<double, std::micro>(d).count();
+}
+
+void report(const char* benchmark,
+            const Config& config,
+            std::size_t payload_size,
+            Recorder& recorder) {
+  auto& lags = recorder.lags;
+  std::sort(lags.begin(), lags.end());
+
+  auto percentile = [&lags](double p) {
+    if (lags.empty()) {
+      return reactor::Duration::zero();
+    }
+    auto index = static_cast<std::size_t>(p * lags.size());
+    return lags[std::min(index, lags.size() - 1)];
+  };
+
+  std::printf("%-8s %9zu %9zu %9zu %12.1f %10.1f %10.1f %10.1f %10.2f\n",
+              benchmark, payload_size, lags.size(),
+              config.messages - lags.size(), recorder.throughput(),
+              to_us(percentile(0.5)), to_us(percentile(0.99)),
+              to_us(percentile(0.999)), recorder.allocations_per_message());
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  Config config;
+  if (argc > 1) {
+    config.messages = std::stoul(argv[1]);
+  }
+  if (argc > 2) {
+    config.period = std::chrono::microseconds{std::stoul(argv[2])};
+  }
+  if (argc > 3) {
+    config.workers = static_cast<unsigned>(std::stoul(argv[3]));
+  }
+
+  const std::vector<std::size_t> payload_sizes{8,         64,        512,
+                                               4 * 1024,  64 * 1024, 256 * 1024,
+                                               1024 * 1024};
+
+  std::printf("%-8s %9s %9s %9s %12s %10s %10s %10s %10s\n", "pair", "bytes",
+              "received", "lost", "msgs/s", "p50[us]", "p99[us]", "p999[us]",
+              "allocs/msg");
+
+  for (auto size : payload_sizes) {
+    Recorder recorder{config.messages};
+    run_event_benchmark(config, size, {}, recorder);
+    report("event", config, size, recorder);
+  }
+
+  for (auto size : payload_sizes) {
+    Recorder recorder{config.messages};
+    dear::ProxyEventOptions options;
+    options.share_samples = true;
+    run_event_benchmark(config, size, options, recorder);
+    report("shared", config, size, recorder);
+  }
+
+  {
+    dear::WorkerPool decode_pool{2};
+    for (auto size : payload_sizes) {
+      Recorder recorder{config.messages};
+      dear::ProxyEventOptions options;
+      options.decode_pool = &decode_pool;
+      run_event_benchmark(config, size, options, recorder);
+      report("decode", config, size, recorder);
+    }
+  }
+
+  for (auto size : payload_sizes) {
+    Recorder recorder{config.messages};
+    run_shm_event_benchmark(config, size, recorder);
+    report("shm", config, size, recorder);
+  }
+
+  std::vector<std::unique_ptr<RequestAllocations>> request_allocations;
+  for (auto size : payload_sizes) {
+    Recorder recorder{config.messages};
+    request_allocations.push_back(std::make_unique<RequestAllocations>());
+    run_method_benchmark(config, size, recorder, *request_allocations.back());
+    report("method", config, size, recorder);
+  }
+
+  // Remaining allocations per request: the promise's shared state, the
+  // argument value and the argument's copy, and the event queue entry of
+  // the first request of a burst (see process_request()).
+  std::printf("\n%-8s %9s %12s %14s\n", "pair", "bytes", "allocs/req",
+              "pool overflows");
+  bool pool_overflow = false;
+  for (std::size_t i = 0; i < payload_sizes.size(); i++) {
+    const auto& allocations = *request_allocations[i];
+    std::printf("%-8s %9zu %12.2f %14zu\n", "method", payload_sizes[i],
+                allocations.per_request(), allocations.pool_heap_allocations);
+    pool_overflow |= allocations.pool_heap_allocations > 0;
+  }
+  if (pool_overflow) {
+    std::fprintf(stderr,
+                 "FAIL: the request pool allocated request data on the heap\n");
+  }
+
+  std::printf("\n%-12s %9s %9s %9s %7s\n", "check", "sent", "received",
+              "in order", "result");
+  bool checks_passed = check_event_group(config);
+  checks_passed &= check_timestamp_trailer(config);
+  checks_passed &= check_batch_samples(config);
+  checks_passed &= check_latest_only(config);
+  checks_passed &= check_unbound_requests(config);
+  checks_passed &= check_send_queue(config);
+  checks_passed &= check_replay(config);
+  if (!checks_passed) {
+    std::fprintf(stderr, "FAIL: a functional check failed\n");
+  }
+  return pool_overflow || !checks_passed ? 1 : 0;
+}
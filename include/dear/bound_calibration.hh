@@ -0,0 +1,138 @@
+/*
+ * Copyright (C) 2020 TU Dresden
+ * All rights reserved.
+ *
+ * Authors:
+ *   Christian Menard
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+
+#include <reactor-cpp/time.hh>
+
+#include "dear/latency_histogram.hh"
+
+namespace dear {
+
+struct CalibrationOptions {
+  // Record the observed latency (arrival time - sender timestamp) of every
+  // received message.
+  bool enabled{false};
+  // Percentile of the observed latencies that the recommended bound covers.
+  double percentile{0.999};
+  // Tighten the bound used for computing release tags at runtime. This
+  // requires enabled to be set. Note that the release tags then depend on the
+  // observed physical latencies, which breaks determinism across runs.
+  bool adapt{false};
+  // The adapted bound is never smaller than this.
+  reactor::Duration min_bound{reactor::Duration::zero()};
+  // Safety margin added to the recommended bound when adapting.
+  reactor::Duration margin{reactor::Duration::zero()};
+  // Number of consecutive messages that must arrive within the current bound
+  // before the bound is tightened.
+  std::uint64_t window{1000};
+};
+
+// Computes release tags of received messages. By default, the release tag is
+// the message timestamp plus the static bound given by max_network_delay +
+// max_synchronization_error. In calibration mode, the observed latencies are
+// recorded in a histogram and a recommended bound is derived from them. In
+// adaptive mode, the bound is tightened to the recommended bound whenever the
+// link has been quiet, i.e., a window of messages arrived within the current
+// bound. As soon as a message arrives late, the bound falls back to the static
+// bound. The adapted bound never exceeds the static bound.
+class BoundCalibration {
+ private:
+  const CalibrationOptions options;
+  const reactor::Duration static_bound;
+  std::unique_ptr<LatencyHistogram> histogram_;
+
+  std::atomic<reactor::Duration::rep> bound;
+  std::uint64_t quiet_messages{0};
+  // timestamp and release tag of the latest message received so far
+  reactor::TimePoint last_timestamp{};
+  reactor::TimePoint last_release_tag{};
+
+  void adapt(reactor::Duration latency) {
+    auto current = current_bound();
+    if (latency >= current) {
+      bound.store(static_bound.count(), std::memory_order_relaxed);
+      quiet_messages = 0;
+      return;
+    }
+
+    if (++quiet_messages >= options.window) {
+      quiet_messages = 0;
+      auto candidate = std::min(
+          std::max(recommended_bound() + options.margin, options.min_bound),
+          static_bound);
+      if (candidate < current) {
+        bound.store(candidate.count(), std::memory_order_relaxed);
+      }
+    }
+  }
+
+ public:
+  BoundCalibration(const CalibrationOptions& options,
+                   reactor::Duration static_bound)
+      : options(options)
+      , static_bound(static_bound)
+      , bound(static_bound.count()) {
+    if (options.enabled) {
+      histogram_ = std::make_unique<LatencyHistogram>();
+    }
+  }
+
+  // Returns the release tag of a message with the given timestamp that
+  // arrived at the given (physical) time.
+  reactor::TimePoint release_tag(const reactor::TimePoint& timestamp,
+                                 const reactor::TimePoint& arrival) {
+    if (histogram_ == nullptr) {
+      return timestamp + static_bound;
+    }
+
+    auto latency = arrival - timestamp;
+    histogram_->record(latency);
+    if (!options.adapt) {
+      return timestamp + static_bound;
+    }
+
+    adapt(latency);
+    auto t = timestamp + current_bound();
+    // Tightening the bound could release a message before one that was sent
+    // earlier. Such a message is held back to the release tag of the earlier
+    // one. The transactors move messages with equal tags apart in the order
+    // they were received. A message with an older timestamp than an earlier
+    // received one keeps its tag, just like with the static bound.
+    if (timestamp >= last_timestamp) {
+      t = std::max(t, last_release_tag);
+      last_timestamp = timestamp;
+      last_release_tag = t;
+    }
+    return t;
+  }
+
+  // The bound that covers the configured percentile of observed latencies,
+  // or the static bound if nothing was recorded yet.
+  reactor::Duration recommended_bound() const {
+    if (histogram_ == nullptr || histogram_->count() == 0) {
+      return static_bound;
+    }
+    return histogram_->value_at_percentile(options.percentile) +
+           reactor::Duration{1};
+  }
+
+  reactor::Duration current_bound() const {
+    return reactor::Duration{bound.load(std::memory_order_relaxed)};
+  }
+
+  // nullptr if calibration is disabled
+  const LatencyHistogram* histogram() const { return histogram_.get(); }
+};
+
+}  // namespace dear
@@ -0,0 +1,78 @@
+/*
+ * Copyright (C) 2020 TU Dresden
+ * All rights reserved.
+ *
+ * Authors:
+ *   Christian Menard
+ */
+
+#pragma once
+
+#include <cassert>
+#include <cstddef>
+#include <cstring>
+#include <type_traits>
+#include <vector>
+
+#include <reactor-cpp/reactor-cpp.hh>
+
+namespace dear {
+
+// Copies values of type T into and out of a flat byte buffer, e.g. a slot of a
+// ShmChannel or a record of a trace. Specialize this for other types that
+// should be transmitted or recorded.
+template <class T, class Enable = void>
+struct Codec;
+
+template <class T>
+struct Codec<T, std::enable_if_t<std::is_trivially_copyable<T>::value>> {
+  static std::size_t size(const T&) { return sizeof(T); }
+
+  static void encode(const T& value, void* data) {
+    std::memcpy(data, &value, sizeof(T));
+  }
+
+  static reactor::ImmutableValuePtr<T> decode(const void* data,
+                                              std::size_t size) {
+    static_assert(std::is_default_constructible<T>::value,
+                  "decoding requires a default constructible type");
+    assert(size == sizeof(T));
+    (void)size;
+    T value;
+    std::memcpy(&value, data, sizeof(T));
+    return reactor::make_immutable_value<T>(value);
+  }
+};
+
+template <class T>
+struct Codec<std::vector<T>,
+             std::enable_if_t<std::is_trivially_copyable<T>::value>> {
+  static std::size_t size(const std::vector<T>& value) {
+    return value.size() * sizeof(T);
+  }
+
+  static void encode(const std::vector<T>& value, void* data) {
+    // data() of an empty vector may be null, which memcpy does not allow
+    if (!value.empty()) {
+      std::memcpy(data, value.data(), value.size() * sizeof(T));
+    }
+  }
+
+  static reactor::ImmutableValuePtr<std::vector<T>> decode(const void* data,
+                                                           std::size_t size) {
+    assert(size % sizeof(T) == 0);
+    auto begin = static_cast<const T*>(data);
+    return reactor::make_immutable_value<std::vector<T>>(
+        begin, begin + size / sizeof(T));
+  }
+};
+
+// true if there is a Codec for T
+template <class T, class Enable = void>
+struct has_codec : std::false_type {};
+
+template <class T>
+struct has_codec<T, std::void_t<decltype(Codec<T>::size(std::declval<T>()))>>
+    : std::true_type {};
+
+}  // namespace dear
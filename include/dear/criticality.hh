@@ -0,0 +1,52 @@
+/*
+ * Copyright (C) 2020 TU Dresden
+ * All rights reserved.
+ *
+ * Authors:
+ *   Christian Menard
+ */
+
+#pragma once
+
+#include <cstdint>
+
+#include <reactor-cpp/time.hh>
+
+namespace dear {
+
+// How important the messages of a transactor are for the system. Under
+// overload, the receives of less critical transactors are shed first, so that
+// the reactor workers stay available for the critical ones.
+enum class Criticality : std::uint8_t {
+  kBestEffort,
+  kNormal,
+  kCritical,
+};
+
+// The reactor program is overloaded if its logical time lags behind physical
+// time, i.e., if received messages are processed later than they arrived.
+// A transactor sheds a received message, instead of scheduling it, if the
+// lag exceeds the threshold for its criticality. Critical messages are never
+// shed. A threshold of zero disables shedding for that criticality.
+struct SheddingOptions {
+  Criticality criticality{Criticality::kNormal};
+  reactor::Duration best_effort_threshold{reactor::Duration::zero()};
+  reactor::Duration normal_threshold{reactor::Duration::zero()};
+
+  bool should_shed(reactor::Duration lag) const {
+    reactor::Duration threshold;
+    switch (criticality) {
+      case Criticality::kBestEffort:
+        threshold = best_effort_threshold;
+        break;
+      case Criticality::kNormal:
+        threshold = normal_threshold;
+        break;
+      default:
+        return false;
+    }
+    return threshold > reactor::Duration::zero() && lag > threshold;
+  }
+};
+
+}  // namespace dear
@@ -0,0 +1,89 @@
+/*
+ * Copyright (C) 2020 TU Dresden
+ * All rights reserved.
+ *
+ * Authors:
+ *   Christian Menard
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace dear {
+
+struct DeltaOptions {
+  // Every keyframe_interval-th message carries the full state, so that
+  // receivers that joined late or lost a message resynchronize. Zero means
+  // that only the first message is a keyframe.
+  std::uint32_t keyframe_interval{100};
+  // Granularity in bytes at which changes are detected. Changed blocks that
+  // are adjacent are transmitted as a single range.
+  std::size_t block_size{64};
+};
+
+// A range of bytes of the state that a message overwrites.
+struct DeltaRange {
+  std::size_t offset;
+  const std::uint8_t* bytes;
+  std::size_t length;
+};
+
+// Encodes successive versions of a state of fixed size as deltas to the
+// previously encoded version. A message consists of a header followed by the
+// changed byte ranges. Keyframes consist of a single range covering the whole
+// state. Header fields are stored in host byte order, so both ends need to
+// agree on it.
+class DeltaEncoder {
+ private:
+  const DeltaOptions options;
+  std::vector<std::uint8_t> last_state;
+  std::uint64_t sequence{0};
+  std::uint64_t since_keyframe{0};
+  bool keyframe_requested{true};
+
+ public:
+  explicit DeltaEncoder(const DeltaOptions& options = {});
+
+  // Encodes the given state into out, replacing its previous contents.
+  // Returns true if the message is a keyframe.
+  bool encode(const void* state,
+              std::size_t size,
+              std::vector<std::uint8_t>& out);
+
+  // Makes the next message a keyframe.
+  void request_keyframe() { keyframe_requested = true; }
+};
+
+// Validates messages produced by a DeltaEncoder and tracks which version of
+// the state the receiver has. The bytes themselves are applied by the caller,
+// which allows it to keep the state wherever it likes.
+class DeltaDecoder {
+ private:
+  std::uint64_t sequence{0};
+  std::size_t state_size{0};
+  bool synchronized{false};
+
+ public:
+  enum class Status {
+    // the ranges need to be applied to the current state
+    kDelta,
+    // the ranges replace the whole state
+    kKeyframe,
+    // The message does not apply to the current state, as a previous message
+    // was lost or the receiver joined late. Wait for the next keyframe.
+    kMissingBase,
+    kMalformed,
+  };
+
+  // Decodes a message into ranges that point into data.
+  Status decode(const void* data,
+                std::size_t size,
+                std::vector<DeltaRange>& ranges);
+
+  std::size_t size() const { return state_size; }
+};
+
+}  // namespace dear
@@ -0,0 +1,184 @@
+/*
+ * Copyright (C) 2020 TU Dresden
+ * All rights reserved.
+ *
+ * Authors:
+ *   Christian Menard
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include <reactor-cpp/reactor-cpp.hh>
+
+#include "dear/delta_codec.hh"
+
+// Reactors for large, slowly changing state that is published every cycle.
+// DeltaStateSender sits in front of a skeleton event transactor and turns each
+// version of the state into a delta message. DeltaStateReceiver sits behind
+// the matching proxy event transactor and reconstructs the state. Both ends
+// transmit the messages as an event of type std::vector<std::uint8_t>, so the
+// deltas work with any transport and keep the release tags of the
+// transactors.
+
+namespace dear {
+
+template <class T>
+class DeltaStateSender : public reactor::Reactor {
+  static_assert(std::is_trivially_copyable<T>::value,
+                "delta encoding requires a trivially copyable state");
+
+ private:
+  // state
+  DeltaEncoder encoder;
+  std::atomic<std::uint64_t> keyframes_{0};
+
+  // reactions
+  reactor::Reaction r_notify{"r_notify", 1, this, [this]() { on_notify(); }};
+
+  // reaction bodies
+  void on_notify() {
+    std::vector<std::uint8_t> message;
+    if (encoder.encode(&(*notify.get()), sizeof(T), message)) {
+      keyframes_.fetch_add(1, std::memory_order_relaxed);
+    }
+    delta.set(std::move(message));
+  }
+
+ public:
+  // ports
+  reactor::Input<T> notify{"notify", this};
+  reactor::Output<std::vector<std::uint8_t>> delta{"delta", this};
+
+  DeltaStateSender(const std::string& name,
+                   reactor::Environment* env,
+                   const DeltaOptions& options = {})
+      : reactor::Reactor(name, env), encoder(options) {}
+
+  DeltaStateSender(const std::string& name,
+                   reactor::Reactor* container,
+                   const DeltaOptions& options = {})
+      : reactor::Reactor(name, container), encoder(options) {}
+
+  void assemble() override {
+    r_notify.declare_trigger(&notify);
+    r_notify.declare_antidependency(&delta);
+  }
+
+  // Makes the next message a keyframe, e.g. when a new receiver subscribed.
+  // Must be called from a reaction or before the environment starts.
+  void request_keyframe() { encoder.request_keyframe(); }
+
+  std::uint64_t keyframes() const {
+    return keyframes_.load(std::memory_order_relaxed);
+  }
+};
+
+// Reconstructs the state into one of two buffers. The new version is written
+// into the buffer that holds the version before the current one, so only the
+// ranges changed by the last two messages need to be copied. If a reactor
+// still holds on to that buffer, it is left alone and a new one is
+// allocated instead.
+template <class T>
+class DeltaStateReceiver : public reactor::Reactor {
+  static_assert(std::is_trivially_copyable<T>::value,
+                "delta encoding requires a trivially copyable state");
+  static_assert(std::is_default_constructible<T>::value,
+                "delta encoding requires a default constructible state");
+
+ private:
+  struct StaleRange {
+    std::size_t offset;
+    std::size_t length;
+  };
+
+  // state
+  DeltaDecoder decoder;
+  std::vector<DeltaRange> ranges;
+  std::shared_ptr<T> front;
+  std::shared_ptr<T> back;
+  // ranges in which back differs from front
+  std::vector<StaleRange> stale_ranges;
+  bool back_synchronized{false};
+  std::atomic<std::uint64_t> dropped_messages_{0};
+
+  // reactions
+  reactor::Reaction r_delta{"r_delta", 1, this, [this]() { on_delta(); }};
+
+  // reaction bodies
+  void on_delta() {
+    const auto& message = *delta.get();
+    auto status = decoder.decode(message.data(), message.size(), ranges);
+    if (status == DeltaDecoder::Status::kMissingBase ||
+        status == DeltaDecoder::Status::kMalformed ||
+        decoder.size() != sizeof(T)) {
+      dropped_messages_.fetch_add(1, std::memory_order_relaxed);
+      return;
+    }
+
+    bool keyframe = status == DeltaDecoder::Status::kKeyframe;
+    if (back == nullptr || back.use_count() > 1) {
+      back = std::make_shared<T>();
+      back_synchronized = false;
+    }
+    if (!keyframe) {
+      if (back_synchronized) {
+        auto source = reinterpret_cast<const std::uint8_t*>(front.get());
+        for (const auto& range : stale_ranges) {
+          std::memcpy(bytes(back) + range.offset, source + range.offset,
+                      range.length);
+        }
+      } else {
+        std::memcpy(back.get(), front.get(), sizeof(T));
+      }
+    }
+
+    stale_ranges.clear();
+    for (const auto& range : ranges) {
+      std::memcpy(bytes(back) + range.offset, range.bytes, range.length);
+      stale_ranges.push_back(StaleRange{range.offset, range.length});
+    }
+
+    std::swap(front, back);
+    // the old front buffer lacks exactly the ranges written above
+    back_synchronized = back != nullptr;
+    notify.set(std::shared_ptr<const T>(front));
+  }
+
+  static std::uint8_t* bytes(const std::shared_ptr<T>& buffer) {
+    return reinterpret_cast<std::uint8_t*>(buffer.get());
+  }
+
+ public:
+  // ports
+  reactor::Input<std::vector<std::uint8_t>> delta{"delta", this};
+  reactor::Output<std::shared_ptr<const T>> notify{"notify", this};
+
+  DeltaStateReceiver(const std::string& name, reactor::Environment* env)
+      : reactor::Reactor(name, env) {}
+
+  DeltaStateReceiver(const std::string& name, reactor::Reactor* container)
+      : reactor::Reactor(name, container) {}
+
+  void assemble() override {
+    r_delta.declare_trigger(&delta);
+    r_delta.declare_antidependency(&notify);
+  }
+
+  // Number of messages that could not be applied, as a previous message was
+  // lost or the receiver joined late. The state is restored by the next
+  // keyframe.
+  std::uint64_t dropped_messages() const {
+    return dropped_messages_.load(std::memory_order_relaxed);
+  }
+};
+
+}  // namespace dear
@@ -0,0 +1,119 @@
+/*
+ * Copyright (C) 2020 TU Dresden
+ * All rights reserved.
+ *
+ * Authors:
+ *   Christian Menard
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <utility>
+#include <vector>
+
+#include <reactor-cpp/time.hh>
+
+#include "dear/method_call_timeout.hh"
+
+namespace dear {
+
+// The calls of a proxy method transactor that are in flight, ordered by their
+// request tag. Responses are released strictly in this order. A response that
+// arrives before the responses of all older calls waits here until they
+// arrived as well or timed out. Each call carries a value of type V, e.g. the
+// future or the decoded response.
+template <class V>
+class InFlightCalls {
+ public:
+  struct Call {
+    std::uint64_t correlation_id;
+    // tag at which the request was issued
+    reactor::TimePoint request_tag;
+    V value;
+    reactor::TimePoint release_tag;
+    bool response_received{false};
+  };
+
+ private:
+  std::deque<Call> calls;
+  const std::size_t capacity;
+  std::uint64_t next_correlation_id_{0};
+  reactor::TimePoint last_release_tag{};
+
+ public:
+  explicit InFlightCalls(std::size_t capacity) : capacity(capacity) {}
+
+  bool full() const { return calls.size() >= capacity; }
+  bool empty() const { return calls.empty(); }
+  std::size_t size() const { return calls.size(); }
+
+  // correlation id that the next added call gets
+  std::uint64_t next_correlation_id() const { return next_correlation_id_; }
+
+  // Adds a call and returns its correlation id. Must not be called if the
+  // table is full.
+  std::uint64_t add(const reactor::TimePoint& request_tag, V value = {}) {
+    auto id = next_correlation_id_++;
+    calls.push_back(Call{id, request_tag, std::move(value), {}, false});
+    return id;
+  }
+
+  // Returns the call with the given correlation id or nullptr if it already
+  // completed or timed out.
+  Call* find(std::uint64_t correlation_id) {
+    // correlation ids are consecutive and calls are only removed from the
+    // front
+    if (calls.empty() || correlation_id < calls.front().correlation_id) {
+      return nullptr;
+    }
+    auto index = correlation_id - calls.front().correlation_id;
+    if (index >= calls.size()) {
+      return nullptr;
+    }
+    return &calls[index];
+  }
+
+  // Removes all calls at the front whose response arrived and passes each to
+  // release(call, t). The release tag t is moved past the one of the previous
+  // response, so that a response is never released before or together with
+  // the response of an older call. release returns true if it scheduled the
+  // response at t.
+  template <class F>
+  void release(F&& release) {
+    while (!calls.empty() && calls.front().response_received) {
+      auto& call = calls.front();
+      auto t = call.release_tag;
+      if (t <= last_release_tag) {
+        t = last_release_tag + reactor::Duration{1};
+      }
+      if (release(call, t)) {
+        last_release_tag = t;
+      }
+      calls.pop_front();
+    }
+  }
+
+  // Removes the oldest calls that were not answered before lt. As all calls
+  // use the same timeout, calls expire in request order.
+  std::vector<MethodCallTimeout> expire(const reactor::TimePoint& lt,
+                                        reactor::Duration timeout) {
+    std::vector<MethodCallTimeout> expired;
+    while (!calls.empty() && !calls.front().response_received &&
+           calls.front().request_tag + timeout <= lt) {
+      expired.push_back(MethodCallTimeout{calls.front().correlation_id,
+                                          calls.front().request_tag});
+      calls.pop_front();
+    }
+    return expired;
+  }
+
+  typename std::deque<Call>::const_iterator begin() const {
+    return calls.begin();
+  }
+  typename std::deque<Call>::const_iterator end() const { return calls.end(); }
+};
+
+}  // namespace dear
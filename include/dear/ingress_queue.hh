@@ -0,0 +1,152 @@
+/*
+ * Copyright (C) 2020 TU Dresden
+ * All rights reserved.
+ *
+ * Authors:
+ *   Christian Menard
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+namespace dear {
+
+// A flag that coalesces wake-ups of a reactor from foreign threads. Only the
+// thread that raises the flag first needs to schedule the physical action,
+// all other threads skip it until the reactor cleared the flag. This keeps
+// bursts of messages from taking the scheduler lock once per message.
+class IngressSignal {
+ private:
+  std::atomic<bool> raised{false};
+
+ public:
+  // Returns true if the caller needs to schedule the physical action.
+  bool raise() { return !raised.exchange(true, std::memory_order_seq_cst); }
+
+  // Must be called by the reaction before it looks at the new data.
+  void clear() { raised.store(false, std::memory_order_seq_cst); }
+};
+
+// A multi-producer/single-consumer queue for handing items from
+// communication threads to a reaction. Items are stored in a bounded
+// lock-free ring buffer (Vyukov's bounded queue). If the ring is full, items
+// spill into a mutex-protected overflow buffer, so that no item is ever
+// dropped. Items in the overflow buffer are drained after the ring.
+template <class T>
+class IngressQueue {
+ private:
+  struct Slot {
+    std::atomic<std::uint64_t> sequence;
+    T item;
+  };
+
+  const std::size_t mask;
+  std::unique_ptr<Slot[]> slots;
+  alignas(64) std::atomic<std::uint64_t> enqueue_position{0};
+  alignas(64) std::uint64_t dequeue_position{0};
+
+  std::mutex overflow_mutex;
+  std::atomic<bool> has_overflow{false};
+  std::vector<T> overflow;
+  std::vector<T> drained_overflow;
+
+  IngressSignal signal;
+
+  static std::size_t round_up(std::size_t capacity) {
+    std::size_t result = 1;
+    while (result < capacity) {
+      result <<= 1;
+    }
+    return result;
+  }
+
+  bool try_push(T& item) {
+    auto position = enqueue_position.load(std::memory_order_relaxed);
+    for (;;) {
+      auto& slot = slots[position & mask];
+      auto sequence = slot.sequence.load(std::memory_order_acquire);
+      auto diff = static_cast<std::int64_t>(sequence - position);
+      if (diff == 0) {
+        if (enqueue_position.compare_exchange_weak(
+                position, position + 1, std::memory_order_relaxed)) {
+          slot.item = std::move(item);
+          slot.sequence.store(position + 1, std::memory_order_seq_cst);
+          return true;
+        }
+      } else if (diff < 0) {
+        return false;
+      } else {
+        position = enqueue_position.load(std::memory_order_relaxed);
+      }
+    }
+  }
+
+ public:
+  explicit IngressQueue(std::size_t capacity = 256)
+      : mask(round_up(capacity) - 1), slots(new Slot[mask + 1]) {
+    for (std::size_t i = 0; i <= mask; i++) {
+      slots[i].sequence.store(i, std::memory_order_relaxed);
+    }
+  }
+
+  IngressQueue(const IngressQueue&) = delete;
+  IngressQueue& operator=(const IngressQueue&) = delete;
+
+  // Adds an item. May be called from any thread. Returns true if the caller
+  // needs to schedule the physical action that drains the queue.
+  bool push(T item) {
+    if (!try_push(item)) {
+      std::lock_guard<std::mutex> lock(overflow_mutex);
+      overflow.push_back(std::move(item));
+      has_overflow.store(true, std::memory_order_seq_cst);
+    }
+    return signal.raise();
+  }
+
+  // Hands all queued items to fn. Must only be called from a single
+  // consumer. Returns the number of items.
+  template <class Fn>
+  std::size_t drain(Fn&& fn) {
+    signal.clear();
+
+    std::size_t count = 0;
+    for (;;) {
+      auto& slot = slots[dequeue_position & mask];
+      if (slot.sequence.load(std::memory_order_seq_cst) !=
+          dequeue_position + 1) {
+        break;
+      }
+      fn(slot.item);
+      slot.item = T{};
+      slot.sequence.store(dequeue_position + mask + 1,
+                          std::memory_order_release);
+      dequeue_position++;
+      count++;
+    }
+
+    if (has_overflow.load(std::memory_order_seq_cst)) {
+      {
+        std::lock_guard<std::mutex> lock(overflow_mutex);
+        std::swap(overflow, drained_overflow);
+        has_overflow.store(false, std::memory_order_relaxed);
+      }
+      for (auto& item : drained_overflow) {
+        fn(item);
+        count++;
+      }
+      drained_overflow.clear();
+    }
+    return count;
+  }
+
+  std::size_t capacity() const { return mask + 1; }
+};
+
+}  // namespace dear
@@ -0,0 +1,135 @@
+/*
+ * Copyright (C) 2020 TU Dresden
+ * All rights reserved.
+ *
+ * Authors:
+ *   Christian Menard
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+
+#include <reactor-cpp/time.hh>
+
+namespace dear {
+
+// A histogram of durations with logarithmic buckets in the style of HDR
+// histograms. Each power of two is split into 2^SubBucketBits linear
+// sub-buckets, which bounds the relative error of a reported value to
+// 2^-SubBucketBits. Values below zero are counted as zero, values above 2^40ns
+// (about 18 minutes) are counted in the last bucket.
+//
+// Recording is lock-free and may happen concurrently to reading. Reads are
+// not synchronized with each other, so a snapshot taken while values are
+// recorded may be slightly inconsistent.
+template <unsigned SubBucketBits>
+class BasicLatencyHistogram {
+ public:
+  static constexpr unsigned kSubBucketBits = SubBucketBits;
+  static constexpr unsigned kMaxValueBits = 40;
+  static constexpr std::size_t kSubBuckets = std::size_t{1} << kSubBucketBits;
+  static constexpr std::size_t kLinearBuckets = 2 * kSubBuckets;
+  static constexpr std::size_t kBucketCount =
+      kLinearBuckets + (kMaxValueBits - kSubBucketBits - 1) * kSubBuckets;
+
+ private:
+  std::array<std::atomic<std::uint64_t>, kBucketCount> buckets;
+  std::atomic<std::uint64_t> count_{0};
+  std::atomic<reactor::Duration::rep> max_{0};
+
+  static std::size_t bucket_index(std::uint64_t value) {
+    if (value < kLinearBuckets) {
+      return static_cast<std::size_t>(value);
+    }
+    unsigned msb = 63 - static_cast<unsigned>(__builtin_clzll(value));
+    if (msb >= kMaxValueBits) {
+      return kBucketCount - 1;
+    }
+    unsigned shift = msb - kSubBucketBits;
+    auto sub_bucket = static_cast<std::size_t>(value >> shift) - kSubBuckets;
+    return kLinearBuckets + (shift - 1) * kSubBuckets + sub_bucket;
+  }
+
+ public:
+  BasicLatencyHistogram() { reset(); }
+
+  // largest value that is counted in the given bucket
+  static std::uint64_t bucket_upper_bound(std::size_t index) {
+    if (index < kLinearBuckets) {
+      return index;
+    }
+    unsigned shift =
+        static_cast<unsigned>((index - kLinearBuckets) / kSubBuckets) + 1;
+    std::uint64_t sub_bucket = (index - kLinearBuckets) % kSubBuckets;
+    return ((kSubBuckets + sub_bucket + 1) << shift) - 1;
+  }
+
+  void record(reactor::Duration value) {
+    auto ns = value.count() < 0 ? 0 : value.count();
+    buckets[bucket_index(static_cast<std::uint64_t>(ns))].fetch_add(
+        1, std::memory_order_relaxed);
+    count_.fetch_add(1, std::memory_order_relaxed);
+
+    auto max = max_.load(std::memory_order_relaxed);
+    while (ns > max &&
+           !max_.compare_exchange_weak(max, ns, std::memory_order_relaxed)) {
+    }
+  }
+
+  void reset() {
+    for (auto& bucket : buckets) {
+      bucket.store(0, std::memory_order_relaxed);
+    }
+    count_.store(0, std::memory_order_relaxed);
+    max_.store(0, std::memory_order_relaxed);
+  }
+
+  std::uint64_t count() const { return count_.load(std::memory_order_relaxed); }
+
+  std::uint64_t bucket_count(std::size_t index) const {
+    return buckets[index].load(std::memory_order_relaxed);
+  }
+
+  reactor::Duration max() const {
+    return reactor::Duration{max_.load(std::memory_order_relaxed)};
+  }
+
+  // Returns an upper bound for the given fraction (0.0 to 1.0) of all
+  // recorded values.
+  reactor::Duration value_at_percentile(double percentile) const {
+    auto total = count();
+    if (total == 0) {
+      return reactor::Duration::zero();
+    }
+
+    auto target = static_cast<std::uint64_t>(
+        std::ceil(percentile * static_cast<double>(total)));
+    if (target == 0) {
+      target = 1;
+    }
+
+    std::uint64_t cumulative = 0;
+    for (std::size_t i = 0; i < kBucketCount; i++) {
+      cumulative += bucket_count(i);
+      if (cumulative >= target) {
+        auto upper = static_cast<reactor::Duration::rep>(bucket_upper_bound(i));
+        // the bucket bound may overshoot the largest recorded value
+        return std::min(reactor::Duration{upper}, max());
+      }
+    }
+    return max();
+  }
+};
+
+// about 6% relative error, 592 buckets
+using LatencyHistogram = BasicLatencyHistogram<4>;
+// about 50% relative error, 80 buckets
+using CoarseLatencyHistogram = BasicLatencyHistogram<1>;
+
+}  // namespace dear
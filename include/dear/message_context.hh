@@ -0,0 +1,72 @@
+/*
+ * Copyright (C) 2020 TU Dresden
+ * All rights reserved.
+ *
+ * Authors:
+ *   Christian Menard
+ */
+
+#pragma once
+
+#include <utility>
+
+#include <reactor-cpp/time.hh>
+
+#include "dear/time_context.hh"
+
+namespace dear {
+
+// Everything the binding needs to know about a message besides its payload.
+// A context is a plain value that is created by the reaction that emits the
+// message. It travels with the message, so the message can be sent later and
+// on another thread than the reaction's.
+struct MessageContext {
+  reactor::TimePoint timestamp;
+};
+
+// Makes the timestamp of a message context available to the binding on the
+// current thread for as long as the scope lives. Scopes may be nested. An
+// inner scope hides the timestamp of the outer one until it ends.
+class TimestampScope {
+ private:
+  const bool outer_valid;
+  const reactor::TimePoint outer_timestamp;
+
+ public:
+  explicit TimestampScope(const MessageContext& context)
+      : outer_valid(TimeContext::valid)
+      , outer_timestamp(TimeContext::timestamp) {
+    TimeContext::valid = true;
+    TimeContext::timestamp = context.timestamp;
+  }
+
+  ~TimestampScope() {
+    TimeContext::valid = outer_valid;
+    TimeContext::timestamp = outer_timestamp;
+  }
+
+  TimestampScope(const TimestampScope&) = delete;
+  TimestampScope& operator=(const TimestampScope&) = delete;
+};
+
+// Sends an event with the given context. The binding still reads the
+// timestamp from TimeContext, which is set on the calling thread for the
+// duration of the call only. The call may thus be made from any thread, as
+// long as the binding attaches the timestamp before Send() returns.
+template <class Event, class T>
+void send_event(Event& event, const T& value, const MessageContext& context) {
+  TimestampScope scope{context};
+  event.Send(value);
+}
+
+// Calls a proxy method with the given context and returns the future of the
+// call. The same restriction as for send_event() applies.
+template <class Method, class... Args>
+auto call_method(Method& method,
+                 const MessageContext& context,
+                 Args&&... args) {
+  TimestampScope scope{context};
+  return method(std::forward<Args>(args)...);
+}
+
+}  // namespace dear
@@ -0,0 +1,39 @@
+/*
+ * Copyright (C) 2020 TU Dresden
+ * All rights reserved.
+ *
+ * Authors:
+ *   Christian Menard
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <stdexcept>
+
+#include <reactor-cpp/reactor-cpp.hh>
+
+namespace dear {
+
+// Emitted on the timeout port of a proxy method transactor if a call was not
+// answered in time. All calls that are given up at the same tag are emitted
+// together.
+struct MethodCallTimeout {
+  std::uint64_t correlation_id;
+  // tag at which the request was issued
+  reactor::TimePoint request_tag;
+};
+
+// Returns the given response timeout of a proxy method transactor or throws
+// if it was not set. There is no sensible default, as the proxy does not know
+// the response deadline of the service nor how many tags its handler takes.
+inline reactor::Duration required_response_timeout(
+    reactor::Duration response_timeout) {
+  if (response_timeout <= reactor::Duration::zero()) {
+    throw std::invalid_argument(
+        "the response timeout of a proxy method transactor must be set");
+  }
+  return response_timeout;
+}
+
+}  // namespace dear
@@ -0,0 +1,106 @@
+/*
+ * Copyright (C) 2020 TU Dresden
+ * All rights reserved.
+ *
+ * Authors:
+ *   Christian Menard
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <reactor-cpp/reactor-cpp.hh>
+
+#include "dear/latency_histogram.hh"
+
+namespace dear {
+
+// Runtime metrics of a single transactor. All fields are updated lock-free
+// from within the transactor and may be read concurrently from any thread.
+struct TransactorMetrics {
+  const std::string name;
+
+  // messages (events, requests or responses) sent to the network
+  std::atomic<std::uint64_t> messages_sent{0};
+  // messages received from the network
+  std::atomic<std::uint64_t> messages_received{0};
+  // received messages that were dropped as their release tag was in the past
+  std::atomic<std::uint64_t> timing_violations{0};
+  // reactions that missed their deadline
+  std::atomic<std::uint64_t> deadline_misses{0};
+  // method calls that were not answered in time
+  std::atomic<std::uint64_t> timeouts{0};
+  // received messages that were shed as the reactor program was overloaded
+  std::atomic<std::uint64_t> shed_messages{0};
+  // messages dropped for other reasons (full queues, unbound transactors)
+  std::atomic<std::uint64_t> dropped_messages{0};
+  // samples that the binding dropped from the event cache before they were
+  // read (gauge, set by receiving event transactors)
+  std::atomic<std::uint64_t> lost_samples{0};
+  // number of requests currently waiting for a response
+  std::atomic<std::uint64_t> pending_requests{0};
+  // slack between the arrival of a message and its release tag
+  CoarseLatencyHistogram slack;
+
+  explicit TransactorMetrics(const std::string& name) : name(name) {}
+
+  // Returns the new value of the counter.
+  static std::uint64_t increment(std::atomic<std::uint64_t>& counter,
+                                 std::uint64_t value = 1) {
+    return counter.fetch_add(value, std::memory_order_relaxed) + value;
+  }
+
+  // Returns true if a counter that just reached count should be logged.
+  // Only powers of two are logged, so that a persistent problem shows up in
+  // the log without flooding it.
+  static bool should_log(std::uint64_t count) {
+    return (count & (count - 1)) == 0;
+  }
+};
+
+// A copy of the metrics of a transactor taken at some point in time.
+struct MetricsSnapshot {
+  std::string name;
+  std::uint64_t messages_sent;
+  std::uint64_t messages_received;
+  std::uint64_t timing_violations;
+  std::uint64_t deadline_misses;
+  std::uint64_t timeouts;
+  std::uint64_t shed_messages;
+  std::uint64_t dropped_messages;
+  std::uint64_t lost_samples;
+  std::uint64_t pending_requests;
+  // slack that 1%, 50% and 99% of the received messages had at most
+  reactor::Duration slack_p1;
+  reactor::Duration slack_p50;
+  reactor::Duration slack_p99;
+  // upper bound and number of messages for each slack histogram bucket
+  std::vector<std::pair<reactor::Duration, std::uint64_t>> slack_histogram;
+};
+
+// Makes the metrics of a transactor available to collect_metrics() for as
+// long as this object lives.
+class MetricsRegistration {
+ private:
+  const reactor::Environment* environment;
+  const TransactorMetrics* metrics;
+
+ public:
+  MetricsRegistration(const reactor::Environment* environment,
+                      const TransactorMetrics* metrics);
+  ~MetricsRegistration();
+
+  MetricsRegistration(const MetricsRegistration&) = delete;
+  MetricsRegistration& operator=(const MetricsRegistration&) = delete;
+};
+
+// Takes a snapshot of the metrics of all transactors in the given
+// environment.
+std::vector<MetricsSnapshot> collect_metrics(
+    const reactor::Environment* environment);
+
+}  // namespace dear
@@ -0,0 +1,96 @@
+/*
+ * Copyright (C) 2020 TU Dresden
+ * All rights reserved.
+ *
+ * Authors:
+ *   Christian Menard
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace dear {
+
+// A pool of objects of type T with a fixed capacity. The storage for all
+// objects is allocated upfront, so that acquiring and releasing objects does
+// not touch the heap. If the pool is exhausted, acquire() falls back to a
+// regular heap allocation and counts it. acquire() and release() may be
+// called from different threads.
+template <class T>
+class ObjectPool {
+ private:
+  using Storage = typename std::aligned_storage<sizeof(T), alignof(T)>::type;
+
+  const std::size_t capacity_;
+  std::unique_ptr<Storage[]> storage;
+  std::vector<Storage*> free_slots;
+  std::mutex mutex;
+  std::atomic<std::size_t> heap_allocations_{0};
+
+  bool owns(const T* object) const {
+    auto p = reinterpret_cast<const Storage*>(object);
+    return p >= storage.get() && p < storage.get() + capacity_;
+  }
+
+ public:
+  explicit ObjectPool(std::size_t capacity)
+      : capacity_(capacity), storage(new Storage[capacity]) {
+    free_slots.reserve(capacity);
+    for (std::size_t i = capacity; i > 0; i--) {
+      free_slots.push_back(&storage[i - 1]);
+    }
+  }
+
+  ~ObjectPool() { assert(free_slots.size() == capacity_); }
+
+  ObjectPool(const ObjectPool&) = delete;
+  ObjectPool& operator=(const ObjectPool&) = delete;
+
+  template <class... Args>
+  T* acquire(Args&&... args) {
+    Storage* slot = nullptr;
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      if (!free_slots.empty()) {
+        slot = free_slots.back();
+        free_slots.pop_back();
+      }
+    }
+
+    if (slot == nullptr) {
+      heap_allocations_.fetch_add(1, std::memory_order_relaxed);
+      return new T(std::forward<Args>(args)...);
+    }
+    return new (slot) T(std::forward<Args>(args)...);
+  }
+
+  void release(T* object) {
+    if (!owns(object)) {
+      delete object;
+      return;
+    }
+
+    object->~T();
+    std::lock_guard<std::mutex> lock(mutex);
+    free_slots.push_back(reinterpret_cast<Storage*>(object));
+  }
+
+  std::size_t capacity() const { return capacity_; }
+
+  // number of objects that did not fit into the pool and were allocated on
+  // the heap instead
+  std::size_t heap_allocations() const {
+    return heap_allocations_.load(std::memory_order_relaxed);
+  }
+};
+
+}  // namespace dear
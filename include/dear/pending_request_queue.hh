@@ -0,0 +1,122 @@
+/*
+ * Copyright (C) 2020 TU Dresden
+ * All rights reserved.
+ *
+ * Authors:
+ *   Christian Menard
+ */
+
+#pragma once
+
+#include <cassert>
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+#include <reactor-cpp/time.hh>
+
+namespace dear {
+
+// A bounded queue of pending requests ordered by their tag. The entries are
+// stored in a ring buffer. Requests typically arrive in tag order, so
+// inserting is usually an append to the back. Requests arriving out of order
+// are sorted in by moving the younger entries back by one slot. Entries with
+// equal tags are kept in insertion order.
+template <class T>
+class PendingRequestQueue {
+ private:
+  struct Entry {
+    reactor::TimePoint tag;
+    T value;
+  };
+
+  std::vector<Entry> buffer;
+  std::size_t head{0};
+  std::size_t size_{0};
+  std::size_t high_water_mark_{0};
+
+  Entry& at(std::size_t index) {
+    return buffer[(head + index) % buffer.size()];
+  }
+  const Entry& at(std::size_t index) const {
+    return buffer[(head + index) % buffer.size()];
+  }
+
+  // index of the first entry with a tag greater than the given one
+  std::size_t upper_bound(const reactor::TimePoint& tag) const {
+    std::size_t low = 0;
+    std::size_t high = size_;
+    while (low < high) {
+      std::size_t mid = low + (high - low) / 2;
+      if (tag < at(mid).tag) {
+        high = mid;
+      } else {
+        low = mid + 1;
+      }
+    }
+    return low;
+  }
+
+ public:
+  explicit PendingRequestQueue(std::size_t capacity) : buffer(capacity) {
+    assert(capacity > 0);
+  }
+
+  // Inserts a new entry and returns false if the queue is full.
+  bool insert(const reactor::TimePoint& tag, T value) {
+    if (size_ == buffer.size()) {
+      return false;
+    }
+
+    std::size_t index = size_;
+    if (size_ > 0 && tag < at(size_ - 1).tag) {
+      index = upper_bound(tag);
+      for (std::size_t i = size_; i > index; i--) {
+        at(i) = std::move(at(i - 1));
+      }
+    }
+    at(index) = Entry{tag, std::move(value)};
+
+    size_++;
+    if (size_ > high_water_mark_) {
+      high_water_mark_ = size_;
+    }
+    return true;
+  }
+
+  bool contains(const reactor::TimePoint& tag) const {
+    std::size_t index = upper_bound(tag);
+    return index > 0 && at(index - 1).tag == tag;
+  }
+
+  const reactor::TimePoint& front_tag() const {
+    assert(size_ > 0);
+    return at(0).tag;
+  }
+
+  T& front() {
+    assert(size_ > 0);
+    return at(0).value;
+  }
+
+  void pop_front() {
+    assert(size_ > 0);
+    at(0).value = T{};
+    head = (head + 1) % buffer.size();
+    size_--;
+  }
+
+  template <class F>
+  void for_each(F&& f) {
+    for (std::size_t i = 0; i < size_; i++) {
+      f(at(i).value);
+    }
+  }
+
+  bool empty() const { return size_ == 0; }
+  std::size_t size() const { return size_; }
+  std::size_t capacity() const { return buffer.size(); }
+  std::size_t high_water_mark() const { return high_water_mark_; }
+};
+
+}  // namespace dear
@@ -8,13 +8,64 @@
 
 #pragma once
 
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
 #include <reactor-cpp/reactor-cpp.hh>
 
 #include "dear/apd_dependencies.hh"
+#include "dear/bound_calibration.hh"
+#include "dear/codec.hh"
+#include "dear/criticality.hh"
+#include "dear/ingress_queue.hh"
+#include "dear/metrics.hh"
+#include "dear/scheduled_tags.hh"
 #include "dear/time_context.hh"
+#include "dear/trace.hh"
+#include "dear/worker_pool.hh"
 
 namespace dear {
 
+struct ProxyEventOptions {
+  // Cache policy and depth used when subscribing to the event. All samples
+  // that arrive in between two triggers and do not fit into the cache are
+  // lost.
+  ara::com::EventCacheUpdatePolicy cache_policy{
+      ara::com::EventCacheUpdatePolicy::kNewestN};
+  std::size_t cache_depth{100};
+  // Deliver all samples that map to the same release tag as a single vector
+  // on the notify_batch port instead of one value per sample on notify.
+  bool batch_samples{false};
+  // Deliver samples on the notify_shared port as pointers that share
+  // ownership of the received sample instead of copying them into notify.
+  // Cannot be combined with batch_samples.
+  bool share_samples{false};
+  // Calibration of the network delay and synchronization error bounds.
+  CalibrationOptions calibration;
+  // If set, samples are read from the binding (and thereby deserialized) by
+  // a job on this pool as soon as the receive handler fires. The reactions
+  // then only compute release tags for values that are ready to use. Samples
+  // are delivered on the notify port. Cannot be combined with batch_samples
+  // or share_samples.
+  WorkerPool* decode_pool{nullptr};
+  // Criticality of the event and when to shed its samples under overload.
+  SheddingOptions shedding;
+
+  // Options for state-like topics where only the most recent sample matters.
+  static ProxyEventOptions latest_only() {
+    ProxyEventOptions options;
+    options.cache_policy = ara::com::EventCacheUpdatePolicy::kLastN;
+    options.cache_depth = 1;
+    return options;
+  }
+};
+
 template <class T>
 class ProxyEventTransactor;
 
@@ -23,87 +74,413 @@ class ProxyEventTransactor<apd::proxy::Event<T>&> : public reactor::Reactor {
  private:
   using Event = apd::proxy::Event<T>;
 
+ public:
+  using ValueType = T;
+  using SamplePtr = typename std::decay<
+      decltype(*std::declval<Event&>().GetCachedSamples().begin())>::type;
+
+ private:
   // state
   Event* event{nullptr};
   apd::Logger& logger;
   const reactor::Duration max_network_delay;
   const reactor::Duration max_synchronization_error;
+  const ProxyEventOptions options;
+  BoundCalibration bound_calibration;
+
+  // metrics
+  TransactorMetrics transactor_metrics{this->fqn()};
+  MetricsRegistration metrics_registration{this->environment(),
+                                           &transactor_metrics};
+
+  // Number of samples announced by the receive handler and number of samples
+  // read from the cache. The difference is the number of samples lost to
+  // cache overflow.
+  std::atomic<std::uint64_t> received_samples{0};
+  std::atomic<std::uint64_t> cached_samples{0};
+  // The trigger is scheduled once per burst of samples, as a single
+  // Update() reads all of them from the cache.
+  IngressSignal trigger_signal;
+
+  // tags at which the send actions are scheduled
+  ScheduledTags send_tags;
+  ScheduledTags send_batch_tags;
+  ScheduledTags send_shared_tags;
+
+  // scratch space used for grouping samples by release tag
+  std::vector<std::pair<reactor::TimePoint, const T*>> batch_buffer;
+
+  // recording
+  TraceWriter* trace{nullptr};
+  std::uint32_t trace_id{0};
+  std::vector<std::uint8_t> trace_buffer;
+
+  // Samples that were decoded off the reactor or injected, together with
+  // their timestamps.
+  IngressQueue<std::pair<reactor::TimePoint, reactor::ImmutableValuePtr<T>>>
+      decoded_samples;
+
+  // Only one decode job per transactor is queued at a time. The mutex keeps
+  // a job that was submitted while another one still runs from reading the
+  // event concurrently.
+  IngressSignal decode_signal;
+  std::mutex decode_mutex;
+  // Jobs refer to this transactor. The destructor sets the stopping flag
+  // and waits until all submitted jobs finished.
+  std::mutex decode_jobs_mutex;
+  std::condition_variable decode_jobs_done;
+  std::size_t decode_jobs{0};
+  bool stopping{false};
 
   // actions
   reactor::PhysicalAction<void> trigger{"trigger", this};
+  reactor::PhysicalAction<void> decoded{"decoded", this};
   reactor::LogicalAction<T> send{"send", this};
+  reactor::LogicalAction<std::vector<T>> send_batch{"send_batch", this};
+  reactor::LogicalAction<SamplePtr> send_shared{"send_shared", this};
 
   // reactions
   reactor::Reaction r_update_binding{"r_update_binding", 1, this,
                                      [this]() { on_update_binding(); }};
   reactor::Reaction r_trigger{"r_trigger", 2, this, [this]() { on_trigger(); }};
   reactor::Reaction r_send{"r_send", 3, this, [this]() { on_send(); }};
+  reactor::Reaction r_send_batch{"r_send_batch", 4, this,
+                                 [this]() { on_send_batch(); }};
+  reactor::Reaction r_send_shared{"r_send_shared", 5, this,
+                                  [this]() { on_send_shared(); }};
+  reactor::Reaction r_decoded{"r_decoded", 6, this,
+                              [this]() { on_decoded(); }};
 
   // reaction bodies
   void on_update_binding() {
     this->event = *update_binding.get();
     if (this->event != nullptr) {
-      event->Subscribe(ara::com::EventCacheUpdatePolicy::kNewestN, 100);
-      event->SetReceiveHandler([this]() { trigger.schedule(); });
+      event->Subscribe(options.cache_policy, options.cache_depth);
+      if (options.decode_pool != nullptr) {
+        event->SetReceiveHandler([this]() {
+          received_samples.fetch_add(1, std::memory_order_relaxed);
+          if (decode_signal.raise()) {
+            submit_decode();
+          }
+        });
+        return;
+      }
+      event->SetReceiveHandler([this]() {
+        received_samples.fetch_add(1, std::memory_order_relaxed);
+        if (trigger_signal.raise()) {
+          trigger.schedule();
+        }
+      });
     }
   }
 
   void on_trigger() {
+    trigger_signal.clear();
     event->Update();
     const auto& samples = event->GetCachedSamples();
+    cached_samples.fetch_add(samples.size(), std::memory_order_relaxed);
+    TransactorMetrics::increment(transactor_metrics.messages_received,
+                                 samples.size());
+    transactor_metrics.lost_samples.store(lost_samples(),
+                                          std::memory_order_relaxed);
+
+    if (overloaded()) {
+      auto lt = get_logical_time();
+      for (const auto& sample : samples) {
+        record_sample(*sample, sample_timestamp(&(*sample)), lt);
+      }
+      TransactorMetrics::increment(transactor_metrics.shed_messages,
+                                   samples.size());
+      TimeContext::invalidate_sample_timestamps();
+      event->Cleanup();
+      return;
+    }
+
+    if (options.batch_samples) {
+      schedule_batches(samples);
+      TimeContext::invalidate_sample_timestamps();
+      event->Cleanup();
+      return;
+    }
 
     for (auto sample : samples) {
-      auto timestamp = TimeContext::retrieve_timestamp();
-      assert(timestamp.HasValue());
-      auto t =
-          timestamp.Value() + max_network_delay + max_synchronization_error;
       auto lt = get_logical_time();
+      auto timestamp = sample_timestamp(&(*sample));
+      record_sample(*sample, timestamp, lt);
+      auto t = bound_calibration.release_tag(timestamp, lt);
 
-      if (t > lt) {
-        send.schedule(*sample, t - lt);
-      } else {
-        logger.LogError() << "Timing violation! Received a message with "
-                             "timestamp in the past!";
+      if (check_release_tag(t, lt)) {
+        if (options.share_samples) {
+          t = send_shared_tags.reserve(t, lt);
+          send_shared.schedule(sample, t - lt);
+        } else {
+          t = send_tags.reserve(t, lt);
+          send.schedule(*sample, t - lt);
+        }
       }
     }
+    TimeContext::invalidate_sample_timestamps();
+    event->Cleanup();
+  }
+
+  // Returns the timestamp the binding attached to the given sample. If there
+  // is none, this falls back to the timestamp provided for the whole update.
+  reactor::TimePoint sample_timestamp(const T* sample) const {
+    auto timestamp = TimeContext::retrieve_sample_timestamp(sample);
+    if (timestamp.HasValue()) {
+      return timestamp.Value();
+    }
+    auto update_timestamp = TimeContext::retrieve_timestamp();
+    assert(update_timestamp.HasValue());
+    return update_timestamp.Value();
+  }
+
+  // Returns true if the samples received in the current reaction are to be
+  // shed, as the reactor program lags too far behind physical time.
+  bool overloaded() const {
+    return options.shedding.should_shed(reactor::get_physical_time() -
+                                        get_logical_time());
+  }
+
+  // Checks whether a message with release tag t can still be scheduled at
+  // logical time lt and accounts for it in the metrics.
+  bool check_release_tag(const reactor::TimePoint& t,
+                         const reactor::TimePoint& lt) {
+    if (t > lt) {
+      transactor_metrics.slack.record(t - lt);
+      return true;
+    }
+    auto count =
+        TransactorMetrics::increment(transactor_metrics.timing_violations);
+    if (TransactorMetrics::should_log(count)) {
+      logger.LogError() << "Timing violation! Received a message with "
+                           "timestamp in the past! ("
+                        << count << " in total)";
+    }
+    return false;
+  }
+
+  // Hands a decode job to the pool unless the transactor is being
+  // destroyed. The job is accounted for before it is submitted, so that the
+  // destructor cannot miss it.
+  void submit_decode() {
+    {
+      std::lock_guard<std::mutex> lock(decode_jobs_mutex);
+      if (stopping) {
+        return;
+      }
+      decode_jobs++;
+    }
+    options.decode_pool->submit([this]() {
+      decode();
+      // notify while holding the lock, as the destructor may return as soon
+      // as it can acquire it
+      std::lock_guard<std::mutex> lock(decode_jobs_mutex);
+      if (--decode_jobs == 0) {
+        decode_jobs_done.notify_all();
+      }
+    });
+  }
+
+  // Runs on the decode pool. Reads all new samples from the binding, copies
+  // them out of the event cache and hands them to the reactor together with
+  // their timestamps.
+  void decode() {
+    std::lock_guard<std::mutex> lock(decode_mutex);
+    decode_signal.clear();
+    event->Update();
+    const auto& samples = event->GetCachedSamples();
+    cached_samples.fetch_add(samples.size(), std::memory_order_relaxed);
+    transactor_metrics.lost_samples.store(lost_samples(),
+                                          std::memory_order_relaxed);
+
+    auto arrival = reactor::get_physical_time();
+    for (const auto& sample : samples) {
+      auto timestamp = sample_timestamp(&(*sample));
+      record_sample(*sample, timestamp, arrival);
+      inject(timestamp, reactor::make_immutable_value<T>(*sample));
+    }
+    TimeContext::invalidate_sample_timestamps();
     event->Cleanup();
   }
 
+  void on_decoded() {
+    auto lt = get_logical_time();
+    bool shed = overloaded();
+    auto count = decoded_samples.drain([this, &lt, shed](auto& sample) {
+      if (shed) {
+        TransactorMetrics::increment(transactor_metrics.shed_messages);
+        return;
+      }
+      auto t = bound_calibration.release_tag(sample.first, lt);
+      if (check_release_tag(t, lt)) {
+        t = send_tags.reserve(t, lt);
+        send.schedule(std::move(sample.second), t - lt);
+      }
+    });
+    TransactorMetrics::increment(transactor_metrics.messages_received, count);
+  }
+
+  void record_sample(const T& sample,
+                     const reactor::TimePoint& timestamp,
+                     const reactor::TimePoint& arrival) {
+    if constexpr (has_codec<T>::value) {
+      if (trace != nullptr) {
+        trace_buffer.resize(Codec<T>::size(sample));
+        Codec<T>::encode(sample, trace_buffer.data());
+        trace->record(trace_id, timestamp, arrival, trace_buffer.data(),
+                      trace_buffer.size());
+      }
+    }
+  }
+
   void on_send() { notify.set(send.get()); }
 
+  void on_send_batch() { notify_batch.set(send_batch.get()); }
+
+  void on_send_shared() { notify_shared.set(send_shared.get()); }
+
+  // Groups all cached samples by their release tag and schedules one
+  // send_batch event per tag. This must be called before event->Cleanup() as
+  // the batch buffer only points into the sample cache.
+  template <class Samples>
+  void schedule_batches(const Samples& samples) {
+    auto lt = get_logical_time();
+
+    batch_buffer.clear();
+    for (const auto& sample : samples) {
+      auto timestamp = sample_timestamp(&(*sample));
+      record_sample(*sample, timestamp, lt);
+      auto t = bound_calibration.release_tag(timestamp, lt);
+
+      if (check_release_tag(t, lt)) {
+        batch_buffer.emplace_back(t, &(*sample));
+      }
+    }
+
+    // samples of different senders may interleave in the cache
+    std::stable_sort(
+        batch_buffer.begin(), batch_buffer.end(),
+        [](const auto& a, const auto& b) { return a.first < b.first; });
+
+    auto it = batch_buffer.begin();
+    while (it != batch_buffer.end()) {
+      auto t = it->first;
+      auto end = std::find_if(it, batch_buffer.end(),
+                              [t](const auto& e) { return e.first != t; });
+
+      std::vector<T> batch;
+      batch.reserve(std::distance(it, end));
+      for (; it != end; ++it) {
+        batch.push_back(*(it->second));
+      }
+      // a batch of an earlier update may already be scheduled at this tag
+      t = send_batch_tags.reserve(t, lt);
+      send_batch.schedule(
+          reactor::make_immutable_value<std::vector<T>>(std::move(batch)),
+          t - lt);
+    }
+    batch_buffer.clear();
+  }
+
  public:
   // potrs
   reactor::Output<T> notify{"notify", this};
+  reactor::Output<std::vector<T>> notify_batch{"notify_batch", this};
+  reactor::Output<SamplePtr> notify_shared{"notify_shared", this};
   reactor::Input<Event*> update_binding{"update_binding", this};
 
   ProxyEventTransactor(const std::string& name,
                        reactor::Environment* env,
                        reactor::Duration max_network_delay,
-                       reactor::Duration max_synchronization_error)
+                       reactor::Duration max_synchronization_error,
+                       const ProxyEventOptions& options = {})
       : reactor::Reactor(name, env)
-      , max_network_delay(max_network_delay)
-      , max_synchronization_error(max_synchronization_error)
       , logger(apd::CreateLogger(name.c_str(),
                                  name.c_str(),
-                                 ara::log::LogLevel::kDebug)) {}
+                                 ara::log::LogLevel::kDebug))
+      , max_network_delay(max_network_delay)
+      , max_synchronization_error(max_synchronization_error)
+      , options(options)
+      , bound_calibration(options.calibration,
+                          max_network_delay + max_synchronization_error) {
+    assert(!(options.batch_samples && options.share_samples));
+    assert(options.decode_pool == nullptr ||
+           !(options.batch_samples || options.share_samples));
+  }
 
   ProxyEventTransactor(const std::string& name,
                        reactor::Reactor* container,
                        reactor::Duration max_network_delay,
-                       reactor::Duration max_synchronization_error)
+                       reactor::Duration max_synchronization_error,
+                       const ProxyEventOptions& options = {})
       : reactor::Reactor(name, container)
-      , max_network_delay(max_network_delay)
-      , max_synchronization_error(max_synchronization_error)
       , logger(apd::CreateLogger(name.c_str(),
                                  name.c_str(),
-                                 ara::log::LogLevel::kDebug)) {}
+                                 ara::log::LogLevel::kDebug))
+      , max_network_delay(max_network_delay)
+      , max_synchronization_error(max_synchronization_error)
+      , options(options)
+      , bound_calibration(options.calibration,
+                          max_network_delay + max_synchronization_error) {
+    assert(!(options.batch_samples && options.share_samples));
+    assert(options.decode_pool == nullptr ||
+           !(options.batch_samples || options.share_samples));
+  }
+
+  ~ProxyEventTransactor() {
+    if (event != nullptr && options.decode_pool != nullptr) {
+      event->UnsetReceiveHandler();
+    }
+    std::unique_lock<std::mutex> lock(decode_jobs_mutex);
+    stopping = true;
+    decode_jobs_done.wait(lock, [this]() { return decode_jobs == 0; });
+  }
+
+  // Number of samples that were received but dropped from the event cache
+  // before they could be processed. Samples that are still waiting in the
+  // cache are included until the next trigger drained them.
+  std::uint64_t lost_samples() const {
+    auto cached = cached_samples.load(std::memory_order_relaxed);
+    auto received = received_samples.load(std::memory_order_relaxed);
+    return received > cached ? received - cached : 0;
+  }
+
+  const BoundCalibration& calibration() const { return bound_calibration; }
+  const TransactorMetrics& metrics() const { return transactor_metrics; }
+
+  // Records all received samples to the given trace. Must be called before
+  // the environment starts.
+  void record_to(TraceWriter* trace) {
+    static_assert(has_codec<T>::value, "recording requires a Codec for T");
+    this->trace = trace;
+    trace_id = trace->register_transactor(this->fqn());
+  }
+
+  // Injects a sample as if it was received from the network with the given
+  // timestamp. This may be called from any thread. Injected samples are
+  // always delivered on the notify port.
+  void inject(const reactor::TimePoint& timestamp,
+              reactor::ImmutableValuePtr<T> value) {
+    if (decoded_samples.push(std::make_pair(timestamp, std::move(value)))) {
+      decoded.schedule();
+    }
+  }
 
   void assemble() override {
     r_update_binding.declare_trigger(&update_binding);
     r_trigger.declare_trigger(&trigger);
     r_trigger.declare_scheduable_action(&send);
+    r_trigger.declare_scheduable_action(&send_batch);
+    r_trigger.declare_scheduable_action(&send_shared);
     r_send.declare_trigger(&send);
     r_send.declare_antidependency(&notify);
+    r_send_batch.declare_trigger(&send_batch);
+    r_send_batch.declare_antidependency(&notify_batch);
+    r_send_shared.declare_trigger(&send_shared);
+    r_send_shared.declare_antidependency(&notify_shared);
+    r_decoded.declare_trigger(&decoded);
+    r_decoded.declare_scheduable_action(&send);
   }
 };
 
@@ -8,14 +8,44 @@
 
 #pragma once
 
+#include <cstdint>
+#include <deque>
+#include <utility>
+#include <vector>
+
 #include <reactor-cpp/reactor-cpp.hh>
 
 #include "dear/apd_dependencies.hh"
+#include "dear/bound_calibration.hh"
+#include "dear/in_flight_calls.hh"
+#include "dear/ingress_queue.hh"
+#include "dear/message_context.hh"
+#include "dear/method_call_timeout.hh"
+#include "dear/metrics.hh"
 #include "dear/time_context.hh"
 #include "dear/type_traits.hh"
 
 namespace dear {
 
+struct ProxyMethodOptions {
+  // Maximum number of calls that may be in flight at the same time. If the
+  // table is full, new requests are dropped. Calls whose response is lost
+  // leave the table once their response timeout expired.
+  std::size_t max_in_flight{64};
+  // Maximum number of requests that are buffered while the transactor is not
+  // bound to a service method. They are sent once it is bound, unless their
+  // deadline expired in the meantime. Zero drops all requests while unbound.
+  std::size_t max_unbound_requests{16};
+  // Time after which a call that was not answered is given up. Must be set.
+  // A response can arrive no earlier than request_deadline plus the response
+  // deadline of the skeleton plus twice max_network_delay +
+  // max_synchronization_error after the request was issued. The timeout needs
+  // to add the time the service takes to answer and a margin on top.
+  reactor::Duration response_timeout{reactor::Duration::zero()};
+  // Calibration of the network delay and synchronization error bounds.
+  CalibrationOptions calibration;
+};
+
 template <class Method>
 class ProxyMethodTransactor;
 
@@ -29,12 +59,16 @@ class ProxyMethodTransactor<apd::proxy::Method<R(Args...)>>
   using RequestType = typename get_request_type<Args...>::type;
 
   struct ResponseData {
-    ResultFutureValue future;
+    std::uint64_t correlation_id;
     reactor::TimePoint timestamp;
+  };
 
-    ResponseData(ResultFutureValue&& future, reactor::TimePoint timestamp)
-        : future(std::forward<ResultFutureValue>(future))
-        , timestamp(timestamp) {}
+  struct OutstandingCall {
+    std::uint64_t correlation_id;
+    // tag at which the request was issued
+    reactor::TimePoint request_tag;
+    // true if the response arrived but waits for older calls to be released
+    bool response_received;
   };
 
  protected:
@@ -44,13 +78,39 @@ class ProxyMethodTransactor<apd::proxy::Method<R(Args...)>>
   const reactor::Duration max_network_delay;
   const reactor::Duration max_synchronization_error;
   apd::Logger& logger;
+  BoundCalibration bound_calibration;
+
+  // metrics
+  TransactorMetrics transactor_metrics{this->fqn()};
+  MetricsRegistration metrics_registration{this->environment(),
+                                           &transactor_metrics};
+
+  // Calls in flight and their futures. The table owns the futures, so that
+  // a call that timed out releases its shared state.
+  const reactor::Duration response_timeout;
+  InFlightCalls<ResultFutureValue> in_flight;
+
+  // requests that arrived while the transactor was not bound
+  using RequestValue =
+      std::conditional_t<std::is_same<void, RequestType>::value,
+                         std::nullptr_t,
+                         reactor::ImmutableValuePtr<RequestType>>;
+  struct UnboundRequest {
+    reactor::TimePoint request_tag;
+    RequestValue args;
+  };
+  const std::size_t max_unbound_requests;
+  std::deque<UnboundRequest> unbound_requests;
+
+  // responses handed over from the communication threads
+  IngressQueue<ResponseData> received_responses;
 
   // actions
   reactor::LogicalAction<ResultFuture> send_response{"send_response", this};
+  reactor::LogicalAction<void> check_timeout{"check_timeout", this};
 
  private:
-  reactor::PhysicalAction<ResponseData> receive_response{"receive_response",
-                                                         this};
+  reactor::PhysicalAction<void> receive_response{"receive_response", this};
 
   // reactions
   reactor::Reaction r_update_binding{"r_update_binding", 1, this,
@@ -60,56 +120,179 @@ class ProxyMethodTransactor<apd::proxy::Method<R(Args...)>>
                                        [this]() { on_receive_response(); }};
   reactor::Reaction r_send_response{"r_send_response", 4, this,
                                     [this]() { on_send_response(); }};
+  reactor::Reaction r_check_timeout{"r_check_timeout", 5, this,
+                                    [this]() { on_check_timeout(); }};
 
   // reaction bodies
-  void on_update_binding() { this->method = *update_binding.get(); }
+  void on_update_binding() {
+    this->method = *update_binding.get();
+    if (method != nullptr) {
+      flush_unbound_requests();
+    }
+  }
 
   void on_request() {
+    RequestValue args{};
+    if constexpr (!std::is_same<void, RequestType>::value) {
+      args = request.get();
+    }
+
     // only send requests if this transactor is bound to a service method
     if (method == nullptr) {
+      buffer_request(args);
+      return;
+    }
+    call(get_logical_time(), args);
+  }
+
+  // Keeps a request until the transactor is bound (again). If the buffer is
+  // full, the oldest request is dropped as it is the first to become stale.
+  void buffer_request(const RequestValue& args) {
+    auto lt = get_logical_time();
+    expire_unbound_requests(lt);
+    if (max_unbound_requests == 0) {
+      TransactorMetrics::increment(transactor_metrics.dropped_messages);
       logger.LogWarn() << "Dropping a request as the transactor was not yet "
                           "bound to a service method";
       return;
     }
+    if (unbound_requests.size() >= max_unbound_requests) {
+      TransactorMetrics::increment(transactor_metrics.dropped_messages);
+      logger.LogWarn() << "Dropping the oldest request buffered while the "
+                          "transactor was not bound to a service method";
+      unbound_requests.pop_front();
+    }
+    unbound_requests.push_back(UnboundRequest{lt, args});
+  }
+
+  // Drops buffered requests that can no longer be sent before their
+  // timestamp (request tag + request deadline) passed.
+  void expire_unbound_requests(const reactor::TimePoint& lt) {
+    while (!unbound_requests.empty() &&
+           unbound_requests.front().request_tag + request_deadline <= lt) {
+      TransactorMetrics::increment(transactor_metrics.dropped_messages);
+      logger.LogWarn() << "Dropping a buffered request as its deadline "
+                          "expired before the transactor was bound";
+      unbound_requests.pop_front();
+    }
+  }
+
+  // Sends all buffered requests in the order of their tags.
+  void flush_unbound_requests() {
+    expire_unbound_requests(get_logical_time());
+    for (const auto& buffered : unbound_requests) {
+      call(buffered.request_tag, buffered.args);
+    }
+    unbound_requests.clear();
+  }
+
+  // Calls the method as if it was called at the given tag. The request is
+  // timestamped with request_tag + request_deadline.
+  void call(const reactor::TimePoint& request_tag, const RequestValue& args) {
+    if (in_flight.full()) {
+      auto count =
+          TransactorMetrics::increment(transactor_metrics.dropped_messages);
+      if (TransactorMetrics::should_log(count)) {
+        logger.LogWarn() << "Dropping a request as there are too many calls "
+                            "in flight ("
+                         << count << " dropped in total)";
+      }
+      return;
+    }
 
-    dear::TimeContext::provide_timestamp(this->get_logical_time() +
-                                         request_deadline);
     apd::Future<R> future;
+    MessageContext context{request_tag + request_deadline};
     if constexpr (std::is_same<void, RequestType>::value) {
-      future = (*(this->method))();
+      (void)args;
+      future = call_method(*method, context);
     } else if constexpr (sizeof...(Args) == 1) {
-      future = (*(this->method))(*request.get());
+      future = call_method(*method, context, *args);
     } else {
-      future = std::apply(*(this->method), *request.get());
+      future = std::apply(
+          [this, &context](const auto&... unpacked) {
+            return call_method(*method, context, unpacked...);
+          },
+          *args);
     }
-    dear::TimeContext::invalidate_timestamp();
+    TransactorMetrics::increment(transactor_metrics.messages_sent);
 
-    // make sure we keep the future alive until the callback is issued
+    // the in-flight table keeps the future alive until the call completes or
+    // times out
     auto future_ptr =
         reactor::make_immutable_value<decltype(future)>(std::move(future));
+    auto id = in_flight.add(request_tag, future_ptr);
+    transactor_metrics.pending_requests.store(in_flight.size(),
+                                              std::memory_order_relaxed);
+    auto lt = get_logical_time();
+    auto timeout_tag = request_tag + response_timeout;
+    check_timeout.schedule(timeout_tag > lt ? timeout_tag - lt
+                                            : reactor::Duration::zero());
+
     // define an asynchronous callback for the response that then triggers a
-    // physical action
-    future_ptr->then([this, future_ptr]() mutable {
+    // physical action. It must not capture the future, as this would keep
+    // the shared state alive forever if the response never arrives.
+    future_ptr->then([this, id]() {
       auto timestamp = TimeContext::retrieve_timestamp();
       assert(timestamp.HasValue());
-      auto response_data = reactor::make_immutable_value<ResponseData>(
-          std::move(future_ptr), timestamp.Value());
-      receive_response.schedule(std::move(response_data));
+      if (received_responses.push(ResponseData{id, timestamp.Value()})) {
+        receive_response.schedule();
+      }
     });
   }
 
   void on_receive_response() {
-    auto response_data = receive_response.get();
-    auto t = response_data->timestamp + max_network_delay +
-             max_synchronization_error;
     auto lt = get_logical_time();
+    received_responses.drain([this, &lt](const ResponseData& response_data) {
+      TransactorMetrics::increment(transactor_metrics.messages_received);
+      auto call = in_flight.find(response_data.correlation_id);
+      if (call == nullptr) {
+        // the call already timed out
+        TransactorMetrics::increment(transactor_metrics.dropped_messages);
+        return;
+      }
+      call->release_tag =
+          bound_calibration.release_tag(response_data.timestamp, lt);
+      call->response_received = true;
+    });
 
-    if (t > lt) {
-      send_response.schedule(std::move(response_data->future), t - lt);
-    } else {
-      logger.LogError() << "Timing violation! Received a message with "
-                           "timestamp in the past!";
+    release_responses(lt);
+  }
+
+  // Releases the responses of all calls at the front of the in-flight table
+  // whose response arrived. A response is never released before the response
+  // of an older call.
+  void release_responses(const reactor::TimePoint& lt) {
+    in_flight.release([this, &lt](auto& call, const reactor::TimePoint& t) {
+      if (t > lt) {
+        transactor_metrics.slack.record(t - lt);
+        send_response.schedule(std::move(call.value), t - lt);
+        return true;
+      }
+      auto count =
+          TransactorMetrics::increment(transactor_metrics.timing_violations);
+      if (TransactorMetrics::should_log(count)) {
+        logger.LogError() << "Timing violation! Received a message with "
+                             "timestamp in the past! ("
+                          << count << " in total)";
+      }
+      return false;
+    });
+    transactor_metrics.pending_requests.store(in_flight.size(),
+                                              std::memory_order_relaxed);
+  }
+
+  // Gives up on the oldest calls if they were not answered in time.
+  void on_check_timeout() {
+    auto lt = get_logical_time();
+    auto expired = in_flight.expire(lt, response_timeout);
+    if (!expired.empty()) {
+      TransactorMetrics::increment(transactor_metrics.timeouts,
+                                   expired.size());
+      logger.LogWarn() << "Method call timed out";
+      timeout.set(std::move(expired));
     }
+    // responses of younger calls may have waited for the expired ones
+    release_responses(lt);
   }
 
   void on_send_response() {
@@ -128,41 +311,78 @@ class ProxyMethodTransactor<apd::proxy::Method<R(Args...)>>
   reactor::Input<RequestType> request{"request", this};
   reactor::Output<R> response{"response", this};
   reactor::Input<Method*> update_binding{"update_binding", this};
+  reactor::Output<std::vector<MethodCallTimeout>> timeout{"timeout", this};
 
   ProxyMethodTransactor(const std::string& name,
                         reactor::Environment* env,
                         reactor::Duration request_deadline,
                         reactor::Duration max_network_delay,
-                        reactor::Duration max_synchronization_error)
+                        reactor::Duration max_synchronization_error,
+                        const ProxyMethodOptions& options)
       : reactor::Reactor(name, env)
       , request_deadline(request_deadline)
       , max_network_delay(max_network_delay)
       , max_synchronization_error(max_synchronization_error)
       , logger(apd::CreateLogger(name.c_str(),
                                  name.c_str(),
-                                 ara::log::LogLevel::kDebug)) {}
+                                 ara::log::LogLevel::kDebug))
+      , bound_calibration(options.calibration,
+                          max_network_delay + max_synchronization_error)
+      , response_timeout(required_response_timeout(options.response_timeout))
+      , in_flight(options.max_in_flight)
+      , max_unbound_requests(options.max_unbound_requests)
+      , received_responses(options.max_in_flight) {}
   ProxyMethodTransactor(const std::string& name,
                         reactor::Reactor* container,
                         reactor::Duration request_deadline,
                         reactor::Duration max_network_delay,
-                        reactor::Duration max_synchronization_error)
+                        reactor::Duration max_synchronization_error,
+                        const ProxyMethodOptions& options)
       : reactor::Reactor(name, container)
       , request_deadline(request_deadline)
       , max_network_delay(max_network_delay)
       , max_synchronization_error(max_synchronization_error)
       , logger(apd::CreateLogger(name.c_str(),
                                  name.c_str(),
-                                 ara::log::LogLevel::kDebug)) {}
+                                 ara::log::LogLevel::kDebug))
+      , bound_calibration(options.calibration,
+                          max_network_delay + max_synchronization_error)
+      , response_timeout(required_response_timeout(options.response_timeout))
+      , in_flight(options.max_in_flight)
+      , max_unbound_requests(options.max_unbound_requests)
+      , received_responses(options.max_in_flight) {}
+
+  const BoundCalibration& calibration() const { return bound_calibration; }
+  const TransactorMetrics& metrics() const { return transactor_metrics; }
+
+  // Returns all calls that are still waiting for their response to be
+  // released. This must not be called concurrently to the transactor's
+  // reactions.
+  std::vector<OutstandingCall> outstanding_calls() const {
+    std::vector<OutstandingCall> calls;
+    calls.reserve(in_flight.size());
+    for (const auto& call : in_flight) {
+      calls.push_back(OutstandingCall{call.correlation_id, call.request_tag,
+                                      call.response_received});
+    }
+    return calls;
+  }
 
   void assemble() override {
     r_update_binding.declare_trigger(&update_binding);
+    r_update_binding.declare_scheduable_action(&check_timeout);
     r_request.declare_trigger(&request);
+    r_request.declare_scheduable_action(&check_timeout);
 
     r_receive_response.declare_trigger(&receive_response);
     r_receive_response.declare_scheduable_action(&send_response);
 
     r_send_response.declare_trigger(&send_response);
     r_send_response.declare_antidependency(&response);
+
+    r_check_timeout.declare_trigger(&check_timeout);
+    r_check_timeout.declare_scheduable_action(&send_response);
+    r_check_timeout.declare_antidependency(&timeout);
   }
 };
 
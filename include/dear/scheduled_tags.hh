@@ -0,0 +1,44 @@
+/*
+ * Copyright (C) 2020 TU Dresden
+ * All rights reserved.
+ *
+ * Authors:
+ *   Christian Menard
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <vector>
+
+#include <reactor-cpp/time.hh>
+
+namespace dear {
+
+// Tracks the future tags at which a logical action is scheduled. Scheduling
+// a logical action twice at the same tag overwrites the first value, so
+// messages whose timestamps map to the same release tag would get lost.
+// reserve() moves such a message to the next free tag, which preserves the
+// order in which the messages were received.
+class ScheduledTags {
+ private:
+  // sorted in ascending order
+  std::vector<reactor::TimePoint> tags;
+
+ public:
+  // Returns the earliest tag not before t that is not yet taken and marks it
+  // as taken. Tags up to the current logical time lt are forgotten.
+  reactor::TimePoint reserve(reactor::TimePoint t,
+                             const reactor::TimePoint& lt) {
+    tags.erase(tags.begin(), std::upper_bound(tags.begin(), tags.end(), lt));
+    auto it = std::lower_bound(tags.begin(), tags.end(), t);
+    while (it != tags.end() && *it == t) {
+      t += reactor::Duration{1};
+      ++it;
+    }
+    tags.insert(it, t);
+    return t;
+  }
+};
+
+}  // namespace dear
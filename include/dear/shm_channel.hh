@@ -0,0 +1,112 @@
+/*
+ * Copyright (C) 2020 TU Dresden
+ * All rights reserved.
+ *
+ * Authors:
+ *   Christian Menard
+ */
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include <reactor-cpp/time.hh>
+
+namespace dear {
+
+struct ShmChannelOptions {
+  // Maximum size of a single message payload in bytes.
+  std::size_t slot_size{4096};
+  // Number of messages the channel can buffer. Rounded up to a power of two.
+  std::size_t capacity{256};
+  // Time to wait for the creator to initialize the segment when opening an
+  // existing one. Opening fails afterwards, e.g. if the creator died.
+  std::chrono::milliseconds open_timeout{1000};
+};
+
+// A message queue in a POSIX shared memory segment that connects transactors
+// on the same host without going through the SOME/IP binding. Each message
+// carries its payload and the timestamp that a binding would otherwise
+// transmit in the message trailer.
+//
+// The queue is a bounded lock-free ring buffer that supports multiple
+// producers and a single consumer. Producers may live in different processes.
+// A process-shared semaphore in the segment counts the queued messages so
+// that the consumer can block while the channel is empty.
+//
+// Only one channel at a time may consume the messages of a segment, see
+// claim_consumer().
+//
+// The segment is created by whichever side opens it first. The configured
+// sizes only take effect at creation. Segments are not removed when the
+// channel is closed, call remove() once all users are done.
+class ShmChannel {
+ public:
+  struct Header;
+
+ private:
+  std::string name_;
+  Header* header{nullptr};
+  std::size_t mapped_size{0};
+  std::uint64_t consumer_claim{0};
+
+  std::uint8_t* slot(std::uint64_t position) const;
+
+ public:
+  ShmChannel(const std::string& name, const ShmChannelOptions& options = {});
+  ~ShmChannel();
+
+  ShmChannel(const ShmChannel&) = delete;
+  ShmChannel& operator=(const ShmChannel&) = delete;
+
+  // Copies a message into the channel. Returns false if the channel is full
+  // or the payload exceeds the slot size.
+  bool try_push(const reactor::TimePoint& timestamp,
+                const void* data,
+                std::size_t size);
+
+  // Registers this channel as the only consumer of the segment. Throws if
+  // another channel of a running process already claimed it. The claim is
+  // given up when this channel is destroyed.
+  void claim_consumer();
+
+  // Hands the next message to fn(timestamp, data, size) and frees its slot.
+  // The data pointer is only valid during the call. Returns false if the
+  // channel is empty. Must only be called by a single consumer.
+  template <class Fn>
+  bool try_pop(Fn&& fn) {
+    const void* data;
+    std::size_t size;
+    reactor::TimePoint timestamp;
+    if (!front(timestamp, data, size)) {
+      return false;
+    }
+    fn(timestamp, data, size);
+    pop();
+    return true;
+  }
+
+  // Blocks until a message was pushed or the timeout expired. Returns false
+  // on timeout. As the consumer may have already popped the message, the
+  // channel can still be empty when this returns true.
+  bool wait(std::chrono::milliseconds timeout);
+
+  bool front(reactor::TimePoint& timestamp,
+             const void*& data,
+             std::size_t& size) const;
+  void pop();
+
+  std::size_t slot_size() const;
+  std::size_t capacity() const;
+  const std::string& name() const { return name_; }
+
+  // Removes the shared memory segment with the given name. Channels that
+  // are still open remain usable.
+  static void remove(const std::string& name);
+};
+
+}  // namespace dear
@@ -0,0 +1,278 @@
+/*
+ * Copyright (C) 2020 TU Dresden
+ * All rights reserved.
+ *
+ * Authors:
+ *   Christian Menard
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cassert>
+#include <memory>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include <reactor-cpp/reactor-cpp.hh>
+
+#include "dear/bound_calibration.hh"
+#include "dear/codec.hh"
+#include "dear/ingress_queue.hh"
+#include "dear/metrics.hh"
+#include "dear/scheduled_tags.hh"
+#include "dear/shm_channel.hh"
+#include "dear/trace.hh"
+
+// Transactors for events between components on the same host. They provide
+// the same ports and release-tag semantics as SkeletonEventTransactor and
+// ProxyEventTransactor, but exchange messages via a ShmChannel instead of the
+// SOME/IP binding. They do not depend on APD.
+
+namespace dear {
+
+template <class T>
+class ShmSkeletonEventTransactor : public reactor::Reactor {
+ private:
+  // state
+  ShmChannel channel;
+  const reactor::Duration deadline;
+  // messages are encoded here first, as the channel copies them into a slot
+  std::vector<std::uint8_t> buffer;
+
+  // metrics
+  TransactorMetrics transactor_metrics{this->fqn()};
+  MetricsRegistration metrics_registration{this->environment(),
+                                           &transactor_metrics};
+
+  // reactions
+  reactor::Reaction r_notify{"r_notify", 1, this, [this]() { on_notify(); }};
+
+  // reaction bodies
+  void on_notify() {
+    const auto& x = *notify.get();
+    auto size = Codec<T>::size(x);
+    if (size > channel.slot_size()) {
+      TransactorMetrics::increment(transactor_metrics.dropped_messages);
+      return;
+    }
+
+    buffer.resize(size);
+    Codec<T>::encode(x, buffer.data());
+    // the same timestamp that the SOME/IP binding would attach
+    if (channel.try_push(this->get_logical_time() + deadline, buffer.data(),
+                         size)) {
+      TransactorMetrics::increment(transactor_metrics.messages_sent);
+    } else {
+      TransactorMetrics::increment(transactor_metrics.dropped_messages);
+    }
+  }
+
+ public:
+  // ports
+  reactor::Input<T> notify{"notify", this};
+
+  ShmSkeletonEventTransactor(const std::string& name,
+                             reactor::Environment* env,
+                             const std::string& channel_name,
+                             reactor::Duration deadline,
+                             const ShmChannelOptions& channel_options = {})
+      : reactor::Reactor(name, env)
+      , channel(channel_name, channel_options)
+      , deadline(deadline) {
+    buffer.reserve(channel.slot_size());
+  }
+
+  ShmSkeletonEventTransactor(const std::string& name,
+                             reactor::Reactor* container,
+                             const std::string& channel_name,
+                             reactor::Duration deadline,
+                             const ShmChannelOptions& channel_options = {})
+      : reactor::Reactor(name, container)
+      , channel(channel_name, channel_options)
+      , deadline(deadline) {
+    buffer.reserve(channel.slot_size());
+  }
+
+  void assemble() override {
+    r_notify.declare_trigger(&notify);
+    r_notify.set_deadline(deadline, [this]() {
+      TransactorMetrics::increment(transactor_metrics.deadline_misses);
+    });
+  }
+
+  const TransactorMetrics& metrics() const { return transactor_metrics; }
+};
+
+template <class T>
+class ShmProxyEventTransactor : public reactor::Reactor {
+ public:
+  using ValueType = T;
+
+ private:
+  struct Message {
+    reactor::TimePoint timestamp;
+    reactor::ImmutableValuePtr<T> value;
+  };
+
+  // state
+  ShmChannel channel;
+  const reactor::Duration max_network_delay;
+  const reactor::Duration max_synchronization_error;
+  BoundCalibration bound_calibration;
+  // tags at which send is scheduled
+  ScheduledTags send_tags;
+
+  // metrics
+  TransactorMetrics transactor_metrics{this->fqn()};
+  MetricsRegistration metrics_registration{this->environment(),
+                                           &transactor_metrics};
+
+  // Messages are decoded by the receive thread and handed over to the
+  // trigger reaction via the incoming queue.
+  std::thread receive_thread;
+  std::atomic<bool> running{false};
+  IngressQueue<Message> incoming_messages;
+
+  // recording
+  TraceWriter* trace{nullptr};
+  std::uint32_t trace_id{0};
+
+  // actions
+  reactor::StartupAction startup{"startup", this};
+  reactor::ShutdownAction shutdown{"shutdown", this};
+  reactor::PhysicalAction<void> trigger{"trigger", this};
+  reactor::LogicalAction<T> send{"send", this};
+
+  // reactions
+  reactor::Reaction r_startup{"r_startup", 1, this, [this]() { start(); }};
+  reactor::Reaction r_trigger{"r_trigger", 2, this, [this]() { on_trigger(); }};
+  reactor::Reaction r_send{"r_send", 3, this, [this]() { on_send(); }};
+  reactor::Reaction r_shutdown{"r_shutdown", 4, this, [this]() { stop(); }};
+
+  // reaction bodies
+  void on_trigger() {
+    auto lt = get_logical_time();
+    incoming_messages.drain([this, &lt](Message& message) {
+      TransactorMetrics::increment(transactor_metrics.messages_received);
+      auto t = bound_calibration.release_tag(message.timestamp, lt);
+      if (t > lt) {
+        transactor_metrics.slack.record(t - lt);
+        t = send_tags.reserve(t, lt);
+        send.schedule(std::move(message.value), t - lt);
+      } else {
+        TransactorMetrics::increment(transactor_metrics.timing_violations);
+      }
+    });
+  }
+
+  void on_send() { notify.set(send.get()); }
+
+  void start() {
+    running.store(true, std::memory_order_relaxed);
+    receive_thread = std::thread([this]() { receive(); });
+  }
+
+  void stop() {
+    running.store(false, std::memory_order_relaxed);
+    if (receive_thread.joinable()) {
+      receive_thread.join();
+    }
+  }
+
+  void receive() {
+    while (running.load(std::memory_order_relaxed)) {
+      if (!channel.wait(std::chrono::milliseconds{100})) {
+        continue;
+      }
+
+      auto receive_message = [this](const reactor::TimePoint& timestamp,
+                                    const void* data, std::size_t size) {
+        if (trace != nullptr) {
+          // the payload is recorded as is, no need to encode it again
+          trace->record(trace_id, timestamp, reactor::get_physical_time(),
+                        data, size);
+        }
+        auto value = Codec<T>::decode(data, size);
+        if (incoming_messages.push(Message{timestamp, std::move(value)})) {
+          trigger.schedule();
+        }
+      };
+      while (channel.try_pop(receive_message)) {
+      }
+    }
+  }
+
+ public:
+  // ports
+  reactor::Output<T> notify{"notify", this};
+
+  ShmProxyEventTransactor(const std::string& name,
+                          reactor::Environment* env,
+                          const std::string& channel_name,
+                          reactor::Duration max_network_delay,
+                          reactor::Duration max_synchronization_error,
+                          const ShmChannelOptions& channel_options = {},
+                          const CalibrationOptions& calibration = {})
+      : reactor::Reactor(name, env)
+      , channel(channel_name, channel_options)
+      , max_network_delay(max_network_delay)
+      , max_synchronization_error(max_synchronization_error)
+      , bound_calibration(calibration,
+                          max_network_delay + max_synchronization_error)
+      , incoming_messages(channel.capacity()) {
+    channel.claim_consumer();
+  }
+
+  ShmProxyEventTransactor(const std::string& name,
+                          reactor::Reactor* container,
+                          const std::string& channel_name,
+                          reactor::Duration max_network_delay,
+                          reactor::Duration max_synchronization_error,
+                          const ShmChannelOptions& channel_options = {},
+                          const CalibrationOptions& calibration = {})
+      : reactor::Reactor(name, container)
+      , channel(channel_name, channel_options)
+      , max_network_delay(max_network_delay)
+      , max_synchronization_error(max_synchronization_error)
+      , bound_calibration(calibration,
+                          max_network_delay + max_synchronization_error)
+      , incoming_messages(channel.capacity()) {
+    channel.claim_consumer();
+  }
+
+  ~ShmProxyEventTransactor() { stop(); }
+
+  // Records all received messages to the given trace. Must be called before
+  // the environment starts.
+  void record_to(TraceWriter* trace) {
+    this->trace = trace;
+    trace_id = trace->register_transactor(this->fqn());
+  }
+
+  // Injects a message as if it was received from the channel with the given
+  // timestamp. This may be called from any thread.
+  void inject(const reactor::TimePoint& timestamp,
+              reactor::ImmutableValuePtr<T> value) {
+    if (incoming_messages.push(Message{timestamp, std::move(value)})) {
+      trigger.schedule();
+    }
+  }
+
+  void assemble() override {
+    r_startup.declare_trigger(&startup);
+    r_trigger.declare_trigger(&trigger);
+    r_trigger.declare_scheduable_action(&send);
+    r_send.declare_trigger(&send);
+    r_send.declare_antidependency(&notify);
+    r_shutdown.declare_trigger(&shutdown);
+  }
+
+  const BoundCalibration& calibration() const { return bound_calibration; }
+  const TransactorMetrics& metrics() const { return transactor_metrics; }
+};
+
+}  // namespace dear
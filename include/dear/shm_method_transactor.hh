@@ -0,0 +1,562 @@
+/*
+ * Copyright (C) 2020 TU Dresden
+ * All rights reserved.
+ *
+ * Authors:
+ *   Christian Menard
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include <reactor-cpp/reactor-cpp.hh>
+
+#include "dear/bound_calibration.hh"
+#include "dear/codec.hh"
+#include "dear/in_flight_calls.hh"
+#include "dear/ingress_queue.hh"
+#include "dear/method_call_timeout.hh"
+#include "dear/metrics.hh"
+#include "dear/pending_request_queue.hh"
+#include "dear/shm_channel.hh"
+
+// Transactors for methods between components on the same host. They compute
+// the same release tags as SkeletonMethodTransactor and ProxyMethodTransactor,
+// but exchange requests and responses via two ShmChannels instead of the
+// SOME/IP binding. A method named "/my_method" uses the channels
+// "/my_method.request" and "/my_method.response". Several clients would
+// receive each other's responses, so each method pair serves a single client.
+// Constructing a second proxy (or skeleton) for the same method throws while
+// the first one exists. They do not depend on APD.
+
+namespace dear {
+
+// Requests and responses carry the id of the call in front of the encoded
+// arguments or return value. T may be void.
+template <class T>
+struct ShmMethodMessage {
+  using Value = std::conditional_t<std::is_void<T>::value,
+                                   std::nullptr_t,
+                                   reactor::ImmutableValuePtr<T>>;
+
+  // Encodes a message into buffer. Returns false if it does not fit into a
+  // slot of the given size.
+  static bool encode(std::uint64_t id,
+                     const Value& value,
+                     std::vector<std::uint8_t>& buffer,
+                     std::size_t slot_size) {
+    std::size_t size = sizeof(id);
+    if constexpr (!std::is_void<T>::value) {
+      size += Codec<T>::size(*value);
+    }
+    if (size > slot_size) {
+      return false;
+    }
+    buffer.resize(size);
+    std::memcpy(buffer.data(), &id, sizeof(id));
+    if constexpr (!std::is_void<T>::value) {
+      Codec<T>::encode(*value, buffer.data() + sizeof(id));
+    } else {
+      (void)value;
+    }
+    return true;
+  }
+
+  static Value decode(const void* data, std::size_t size, std::uint64_t& id) {
+    assert(size >= sizeof(id));
+    std::memcpy(&id, data, sizeof(id));
+    if constexpr (std::is_void<T>::value) {
+      return nullptr;
+    } else {
+      auto payload = static_cast<const std::uint8_t*>(data) + sizeof(id);
+      return Codec<T>::decode(payload, size - sizeof(id));
+    }
+  }
+};
+
+struct ShmSkeletonMethodOptions {
+  // Options of both channels. They only take effect if this side creates
+  // the channels.
+  ShmChannelOptions channel;
+  // Maximum number of requests that were received but not yet answered.
+  // Further requests are dropped.
+  std::size_t max_pending_requests{64};
+  // Calibration of the network delay and synchronization error bounds.
+  CalibrationOptions calibration;
+};
+
+struct ShmProxyMethodOptions {
+  // Options of both channels. They only take effect if this side creates
+  // the channels.
+  ShmChannelOptions channel;
+  // Maximum number of calls that may be in flight at the same time. If the
+  // table is full, new requests are dropped.
+  std::size_t max_in_flight{64};
+  // Time after which a call that was not answered is given up. Must be set.
+  // A response can arrive no earlier than request_deadline plus the response
+  // deadline of the skeleton plus twice max_network_delay +
+  // max_synchronization_error after the request was issued. The timeout needs
+  // to add the time the service takes to answer and a margin on top.
+  reactor::Duration response_timeout{reactor::Duration::zero()};
+  // Calibration of the network delay and synchronization error bounds.
+  CalibrationOptions calibration;
+};
+
+template <class Request, class Response>
+class ShmSkeletonMethodTransactor : public reactor::Reactor {
+ private:
+  using RequestMessage = ShmMethodMessage<Request>;
+  using ResponseMessage = ShmMethodMessage<Response>;
+
+  struct IncomingRequest {
+    reactor::TimePoint timestamp;
+    std::uint64_t id;
+    typename RequestMessage::Value args;
+  };
+
+  // state
+  ShmChannel request_channel;
+  ShmChannel response_channel;
+  const reactor::Duration response_deadline;
+  const reactor::Duration max_network_delay;
+  const reactor::Duration max_synchronization_error;
+  BoundCalibration bound_calibration;
+  // ids of the released requests that were not yet answered, ordered by
+  // their release tags
+  PendingRequestQueue<std::uint64_t> pending_requests;
+  // responses are encoded here first, as the channel copies them into a slot
+  std::vector<std::uint8_t> buffer;
+
+  // metrics
+  TransactorMetrics transactor_metrics{this->fqn()};
+  MetricsRegistration metrics_registration{this->environment(),
+                                           &transactor_metrics};
+
+  // Requests are decoded by the receive thread and handed over to the
+  // receive reaction via the incoming queue.
+  std::thread receive_thread;
+  std::atomic<bool> running{false};
+  IngressQueue<IncomingRequest> incoming_requests;
+
+  // actions
+  reactor::StartupAction startup{"startup", this};
+  reactor::ShutdownAction shutdown{"shutdown", this};
+  reactor::PhysicalAction<void> receive_request{"receive_request", this};
+  reactor::LogicalAction<Request> send_request{"send_request", this};
+
+  // reactions
+  reactor::Reaction r_startup{"r_startup", 1, this, [this]() { start(); }};
+  reactor::Reaction r_receive_request{"r_receive_request", 2, this,
+                                      [this]() { on_receive_request(); }};
+  reactor::Reaction r_send_request{"r_send_request", 3, this,
+                                   [this]() { on_send_request(); }};
+  reactor::Reaction r_response{"r_response", 4, this,
+                               [this]() { on_response(); }};
+  reactor::Reaction r_shutdown{"r_shutdown", 5, this, [this]() { stop(); }};
+
+  // reaction bodies
+  void on_receive_request() {
+    auto lt = get_logical_time();
+    incoming_requests.drain([this, &lt](IncomingRequest& incoming) {
+      TransactorMetrics::increment(transactor_metrics.messages_received);
+      auto t = bound_calibration.release_tag(incoming.timestamp, lt);
+      if (t <= lt) {
+        TransactorMetrics::increment(transactor_metrics.timing_violations);
+        return;
+      }
+
+      // requests with identical timestamps would overwrite each other
+      while (pending_requests.contains(t)) {
+        t += reactor::Duration{1};
+      }
+      if (!pending_requests.insert(t, incoming.id)) {
+        TransactorMetrics::increment(transactor_metrics.dropped_messages);
+        return;
+      }
+      transactor_metrics.slack.record(t - lt);
+      transactor_metrics.pending_requests.store(pending_requests.size(),
+                                                std::memory_order_relaxed);
+
+      if constexpr (std::is_void<Request>::value) {
+        send_request.schedule(t - lt);
+      } else {
+        send_request.schedule(std::move(incoming.args), t - lt);
+      }
+    });
+  }
+
+  void on_send_request() {
+    if constexpr (std::is_void<Request>::value) {
+      request.set();
+    } else {
+      request.set(send_request.get());
+    }
+  }
+
+  void on_response() {
+    assert(!pending_requests.empty());
+    auto id = pending_requests.front();
+    pending_requests.pop_front();
+    transactor_metrics.pending_requests.store(pending_requests.size(),
+                                              std::memory_order_relaxed);
+
+    typename ResponseMessage::Value value{};
+    if constexpr (!std::is_void<Response>::value) {
+      value = response.get();
+    }
+    // the same timestamp that the SOME/IP binding would attach
+    if (ResponseMessage::encode(id, value, buffer,
+                                response_channel.slot_size()) &&
+        response_channel.try_push(get_logical_time() + response_deadline,
+                                  buffer.data(), buffer.size())) {
+      TransactorMetrics::increment(transactor_metrics.messages_sent);
+    } else {
+      TransactorMetrics::increment(transactor_metrics.dropped_messages);
+    }
+  }
+
+  void start() {
+    running.store(true, std::memory_order_relaxed);
+    receive_thread = std::thread([this]() { receive(); });
+  }
+
+  void stop() {
+    running.store(false, std::memory_order_relaxed);
+    if (receive_thread.joinable()) {
+      receive_thread.join();
+    }
+  }
+
+  void receive() {
+    auto receive_message = [this](const reactor::TimePoint& timestamp,
+                                  const void* data, std::size_t size) {
+      std::uint64_t id;
+      auto args = RequestMessage::decode(data, size, id);
+      if (incoming_requests.push(IncomingRequest{timestamp, id, args})) {
+        receive_request.schedule();
+      }
+    };
+    while (running.load(std::memory_order_relaxed)) {
+      if (request_channel.wait(std::chrono::milliseconds{100})) {
+        while (request_channel.try_pop(receive_message)) {
+        }
+      }
+    }
+  }
+
+ public:
+  // ports
+  reactor::Output<Request> request{"request", this};
+  reactor::Input<Response> response{"response", this};
+
+  ShmSkeletonMethodTransactor(const std::string& name,
+                              reactor::Environment* env,
+                              const std::string& method_name,
+                              reactor::Duration response_deadline,
+                              reactor::Duration max_network_delay,
+                              reactor::Duration max_synchronization_error,
+                              const ShmSkeletonMethodOptions& options = {})
+      : reactor::Reactor(name, env)
+      , request_channel(method_name + ".request", options.channel)
+      , response_channel(method_name + ".response", options.channel)
+      , response_deadline(response_deadline)
+      , max_network_delay(max_network_delay)
+      , max_synchronization_error(max_synchronization_error)
+      , bound_calibration(options.calibration,
+                          max_network_delay + max_synchronization_error)
+      , pending_requests(options.max_pending_requests)
+      , incoming_requests(request_channel.capacity()) {
+    request_channel.claim_consumer();
+    buffer.reserve(response_channel.slot_size());
+  }
+
+  ShmSkeletonMethodTransactor(const std::string& name,
+                              reactor::Reactor* container,
+                              const std::string& method_name,
+                              reactor::Duration response_deadline,
+                              reactor::Duration max_network_delay,
+                              reactor::Duration max_synchronization_error,
+                              const ShmSkeletonMethodOptions& options = {})
+      : reactor::Reactor(name, container)
+      , request_channel(method_name + ".request", options.channel)
+      , response_channel(method_name + ".response", options.channel)
+      , response_deadline(response_deadline)
+      , max_network_delay(max_network_delay)
+      , max_synchronization_error(max_synchronization_error)
+      , bound_calibration(options.calibration,
+                          max_network_delay + max_synchronization_error)
+      , pending_requests(options.max_pending_requests)
+      , incoming_requests(request_channel.capacity()) {
+    request_channel.claim_consumer();
+    buffer.reserve(response_channel.slot_size());
+  }
+
+  ~ShmSkeletonMethodTransactor() { stop(); }
+
+  void assemble() override {
+    r_startup.declare_trigger(&startup);
+    r_receive_request.declare_trigger(&receive_request);
+    r_receive_request.declare_scheduable_action(&send_request);
+    r_send_request.declare_trigger(&send_request);
+    r_send_request.declare_antidependency(&request);
+    r_response.declare_trigger(&response);
+    r_shutdown.declare_trigger(&shutdown);
+  }
+
+  const BoundCalibration& calibration() const { return bound_calibration; }
+  const TransactorMetrics& metrics() const { return transactor_metrics; }
+};
+
+template <class Request, class Response>
+class ShmProxyMethodTransactor : public reactor::Reactor {
+ private:
+  using RequestMessage = ShmMethodMessage<Request>;
+  using ResponseMessage = ShmMethodMessage<Response>;
+
+  struct IncomingResponse {
+    reactor::TimePoint timestamp;
+    std::uint64_t id;
+    typename ResponseMessage::Value value;
+  };
+
+  // state
+  ShmChannel request_channel;
+  ShmChannel response_channel;
+  const reactor::Duration request_deadline;
+  const reactor::Duration max_network_delay;
+  const reactor::Duration max_synchronization_error;
+  BoundCalibration bound_calibration;
+  const reactor::Duration response_timeout;
+  // calls in flight and their responses once they arrived
+  InFlightCalls<typename ResponseMessage::Value> in_flight;
+  // requests are encoded here first, as the channel copies them into a slot
+  std::vector<std::uint8_t> buffer;
+
+  // metrics
+  TransactorMetrics transactor_metrics{this->fqn()};
+  MetricsRegistration metrics_registration{this->environment(),
+                                           &transactor_metrics};
+
+  // Responses are decoded by the receive thread and handed over to the
+  // receive reaction via the incoming queue.
+  std::thread receive_thread;
+  std::atomic<bool> running{false};
+  IngressQueue<IncomingResponse> incoming_responses;
+
+  // actions
+  reactor::StartupAction startup{"startup", this};
+  reactor::ShutdownAction shutdown{"shutdown", this};
+  reactor::PhysicalAction<void> receive_response{"receive_response", this};
+  reactor::LogicalAction<Response> send_response{"send_response", this};
+  reactor::LogicalAction<void> check_timeout{"check_timeout", this};
+
+  // reactions
+  reactor::Reaction r_startup{"r_startup", 1, this, [this]() { start(); }};
+  reactor::Reaction r_request{"r_request", 2, this, [this]() { on_request(); }};
+  reactor::Reaction r_receive_response{"r_receive_response", 3, this,
+                                       [this]() { on_receive_response(); }};
+  reactor::Reaction r_send_response{"r_send_response", 4, this,
+                                    [this]() { on_send_response(); }};
+  reactor::Reaction r_check_timeout{"r_check_timeout", 5, this,
+                                    [this]() { on_check_timeout(); }};
+  reactor::Reaction r_shutdown{"r_shutdown", 6, this, [this]() { stop(); }};
+
+  // reaction bodies
+  void on_request() {
+    typename RequestMessage::Value args{};
+    if constexpr (!std::is_void<Request>::value) {
+      args = request.get();
+    }
+
+    if (in_flight.full()) {
+      TransactorMetrics::increment(transactor_metrics.dropped_messages);
+      return;
+    }
+
+    auto id = in_flight.next_correlation_id();
+    auto lt = get_logical_time();
+    // the same timestamp that the SOME/IP binding would attach
+    if (!RequestMessage::encode(id, args, buffer,
+                                request_channel.slot_size()) ||
+        !request_channel.try_push(lt + request_deadline, buffer.data(),
+                                  buffer.size())) {
+      TransactorMetrics::increment(transactor_metrics.dropped_messages);
+      return;
+    }
+    TransactorMetrics::increment(transactor_metrics.messages_sent);
+
+    in_flight.add(lt);
+    transactor_metrics.pending_requests.store(in_flight.size(),
+                                              std::memory_order_relaxed);
+    check_timeout.schedule(response_timeout);
+  }
+
+  void on_receive_response() {
+    auto lt = get_logical_time();
+    incoming_responses.drain([this, &lt](IncomingResponse& incoming) {
+      TransactorMetrics::increment(transactor_metrics.messages_received);
+      auto call = in_flight.find(incoming.id);
+      if (call == nullptr) {
+        // the call already timed out
+        TransactorMetrics::increment(transactor_metrics.dropped_messages);
+        return;
+      }
+      call->release_tag = bound_calibration.release_tag(incoming.timestamp, lt);
+      call->value = std::move(incoming.value);
+      call->response_received = true;
+    });
+    release_responses(lt);
+  }
+
+  // Releases the responses of all calls at the front of the in-flight table
+  // whose response arrived. A response is never released before the response
+  // of an older call.
+  void release_responses(const reactor::TimePoint& lt) {
+    in_flight.release([this, &lt](auto& call, const reactor::TimePoint& t) {
+      if (t <= lt) {
+        TransactorMetrics::increment(transactor_metrics.timing_violations);
+        return false;
+      }
+      transactor_metrics.slack.record(t - lt);
+      if constexpr (std::is_void<Response>::value) {
+        send_response.schedule(t - lt);
+      } else {
+        send_response.schedule(std::move(call.value), t - lt);
+      }
+      return true;
+    });
+    transactor_metrics.pending_requests.store(in_flight.size(),
+                                              std::memory_order_relaxed);
+  }
+
+  // Gives up on the oldest calls if they were not answered in time.
+  void on_check_timeout() {
+    auto lt = get_logical_time();
+    auto expired = in_flight.expire(lt, response_timeout);
+    if (!expired.empty()) {
+      TransactorMetrics::increment(transactor_metrics.timeouts,
+                                   expired.size());
+      timeout.set(std::move(expired));
+    }
+    // responses of younger calls may have waited for the expired ones
+    release_responses(lt);
+  }
+
+  void on_send_response() {
+    if constexpr (std::is_void<Response>::value) {
+      response.set();
+    } else {
+      response.set(send_response.get());
+    }
+  }
+
+  void start() {
+    running.store(true, std::memory_order_relaxed);
+    receive_thread = std::thread([this]() { receive(); });
+  }
+
+  void stop() {
+    running.store(false, std::memory_order_relaxed);
+    if (receive_thread.joinable()) {
+      receive_thread.join();
+    }
+  }
+
+  void receive() {
+    auto receive_message = [this](const reactor::TimePoint& timestamp,
+                                  const void* data, std::size_t size) {
+      std::uint64_t id;
+      auto value = ResponseMessage::decode(data, size, id);
+      if (incoming_responses.push(IncomingResponse{timestamp, id, value})) {
+        receive_response.schedule();
+      }
+    };
+    while (running.load(std::memory_order_relaxed)) {
+      if (response_channel.wait(std::chrono::milliseconds{100})) {
+        while (response_channel.try_pop(receive_message)) {
+        }
+      }
+    }
+  }
+
+ public:
+  // ports
+  reactor::Input<Request> request{"request", this};
+  reactor::Output<Response> response{"response", this};
+  reactor::Output<std::vector<MethodCallTimeout>> timeout{"timeout", this};
+
+  ShmProxyMethodTransactor(const std::string& name,
+                           reactor::Environment* env,
+                           const std::string& method_name,
+                           reactor::Duration request_deadline,
+                           reactor::Duration max_network_delay,
+                           reactor::Duration max_synchronization_error,
+                           const ShmProxyMethodOptions& options)
+      : reactor::Reactor(name, env)
+      , request_channel(method_name + ".request", options.channel)
+      , response_channel(method_name + ".response", options.channel)
+      , request_deadline(request_deadline)
+      , max_network_delay(max_network_delay)
+      , max_synchronization_error(max_synchronization_error)
+      , bound_calibration(options.calibration,
+                          max_network_delay + max_synchronization_error)
+      , response_timeout(required_response_timeout(options.response_timeout))
+      , in_flight(options.max_in_flight)
+      , incoming_responses(response_channel.capacity()) {
+    response_channel.claim_consumer();
+    buffer.reserve(request_channel.slot_size());
+  }
+
+  ShmProxyMethodTransactor(const std::string& name,
+                           reactor::Reactor* container,
+                           const std::string& method_name,
+                           reactor::Duration request_deadline,
+                           reactor::Duration max_network_delay,
+                           reactor::Duration max_synchronization_error,
+                           const ShmProxyMethodOptions& options)
+      : reactor::Reactor(name, container)
+      , request_channel(method_name + ".request", options.channel)
+      , response_channel(method_name + ".response", options.channel)
+      , request_deadline(request_deadline)
+      , max_network_delay(max_network_delay)
+      , max_synchronization_error(max_synchronization_error)
+      , bound_calibration(options.calibration,
+                          max_network_delay + max_synchronization_error)
+      , response_timeout(required_response_timeout(options.response_timeout))
+      , in_flight(options.max_in_flight)
+      , incoming_responses(response_channel.capacity()) {
+    response_channel.claim_consumer();
+    buffer.reserve(request_channel.slot_size());
+  }
+
+  ~ShmProxyMethodTransactor() { stop(); }
+
+  void assemble() override {
+    r_startup.declare_trigger(&startup);
+    r_request.declare_trigger(&request);
+    r_request.declare_scheduable_action(&check_timeout);
+    r_receive_response.declare_trigger(&receive_response);
+    r_receive_response.declare_scheduable_action(&send_response);
+    r_send_response.declare_trigger(&send_response);
+    r_send_response.declare_antidependency(&response);
+    r_check_timeout.declare_trigger(&check_timeout);
+    r_check_timeout.declare_scheduable_action(&send_response);
+    r_check_timeout.declare_antidependency(&timeout);
+    r_shutdown.declare_trigger(&shutdown);
+  }
+
+  const BoundCalibration& calibration() const { return bound_calibration; }
+  const TransactorMetrics& metrics() const { return transactor_metrics; }
+};
+
+}  // namespace dear
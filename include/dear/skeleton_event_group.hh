@@ -0,0 +1,122 @@
+/*
+ * Copyright (C) 2020 TU Dresden
+ * All rights reserved.
+ *
+ * Authors:
+ *   Christian Menard
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <reactor-cpp/reactor-cpp.hh>
+
+#include "dear/apd_dependencies.hh"
+#include "dear/message_context.hh"
+#include "dear/metrics.hh"
+#include "dear/time_context.hh"
+
+namespace dear {
+
+// Sends the events of a group of SkeletonEventTransactors together. Members
+// only queue their notifications. Once all members reacted at a tag, the group
+// hands all queued events to the binding in one go, in the order the members
+// joined, and under a single timestamp (tag + deadline of the group). Each
+// payload is passed to the binding by reference, so it is serialized once
+// by the binding and never copied by DEAR.
+class SkeletonEventGroup : public reactor::Reactor {
+ private:
+  struct Member {
+    std::unique_ptr<reactor::Input<void>> queued;
+    std::function<void()> send;
+  };
+
+  // state
+  const reactor::Duration deadline;
+  apd::Logger& logger;
+  std::vector<Member> members;
+  // Set by the members when they queued an event. Each member only writes its
+  // own entry, and the reactions of the members precede the flush reaction.
+  std::vector<std::uint8_t> pending;
+
+  // metrics
+  TransactorMetrics transactor_metrics{this->fqn()};
+  MetricsRegistration metrics_registration{this->environment(),
+                                           &transactor_metrics};
+
+  // reactions
+  reactor::Reaction r_flush{"r_flush", 1, this, [this]() { on_flush(); }};
+
+  // reaction bodies
+  void on_flush() {
+    TimestampScope scope{MessageContext{this->get_logical_time() + deadline}};
+    std::uint64_t sent = 0;
+    for (std::size_t i = 0; i < members.size(); i++) {
+      if (pending[i] != 0) {
+        members[i].send();
+        pending[i] = 0;
+        sent++;
+      }
+    }
+    TransactorMetrics::increment(transactor_metrics.messages_sent, sent);
+  }
+
+ public:
+  SkeletonEventGroup(const std::string& name,
+                     reactor::Environment* env,
+                     reactor::Duration deadline)
+      : reactor::Reactor(name, env)
+      , deadline(deadline)
+      , logger(apd::CreateLogger(name.c_str(),
+                                 name.c_str(),
+                                 ara::log::LogLevel::kDebug)) {}
+
+  SkeletonEventGroup(const std::string& name,
+                     reactor::Reactor* container,
+                     reactor::Duration deadline)
+      : reactor::Reactor(name, container)
+      , deadline(deadline)
+      , logger(apd::CreateLogger(name.c_str(),
+                                 name.c_str(),
+                                 ara::log::LogLevel::kDebug)) {}
+
+  // Adds a member that sends its queued event when send is called. Returns
+  // the member's index and the port the member needs to bind its queued
+  // output to in its assemble(). As it creates a port, this must be called
+  // while the reactors are constructed.
+  std::pair<std::size_t, reactor::Input<void>*> add_member(
+      std::function<void()> send) {
+    auto index = members.size();
+    auto queued = std::make_unique<reactor::Input<void>>(
+        "queued_" + std::to_string(index), this);
+    auto port = queued.get();
+    members.push_back(Member{std::move(queued), std::move(send)});
+    pending.push_back(0);
+    return {index, port};
+  }
+
+  void queue(std::size_t member) { pending[member] = 1; }
+
+  void assemble() override {
+    for (auto& member : members) {
+      r_flush.declare_trigger(member.queued.get());
+    }
+    r_flush.set_deadline(deadline, [this]() {
+      auto count =
+          TransactorMetrics::increment(transactor_metrics.deadline_misses);
+      if (TransactorMetrics::should_log(count)) {
+        logger.LogError() << "Missed the deadline! (" << count << " in total)";
+      }
+    });
+  }
+
+  reactor::Duration group_deadline() const { return deadline; }
+  const TransactorMetrics& metrics() const { return transactor_metrics; }
+};
+
+}  // namespace dear
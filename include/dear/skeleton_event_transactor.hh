@@ -8,13 +8,40 @@
 
 #pragma once
 
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+
 #include <reactor-cpp/reactor-cpp.hh>
 
 #include "dear/apd_dependencies.hh"
+#include "dear/message_context.hh"
+#include "dear/metrics.hh"
+#include "dear/skeleton_event_group.hh"
 #include "dear/time_context.hh"
 
 namespace dear {
 
+enum class SendQueuePolicy {
+  // if the queue is full, drop the oldest queued event
+  kDropOldest,
+  // if the queue is full, drop the event that is about to be queued
+  kDropNewest,
+  // drop events whose timestamp (tag + deadline) passed before they could be
+  // sent and, if the queue is full, the event that is about to be queued
+  kDropStale,
+};
+
+struct SkeletonEventOptions {
+  // Number of events that may wait for being sent. If this is non-zero,
+  // events are handed to the binding by a separate sender thread, so that a
+  // saturated link does not block the reactor. Zero sends events directly
+  // from the reaction.
+  std::size_t queue_depth{0};
+  SendQueuePolicy policy{SendQueuePolicy::kDropStale};
+};
+
 template <class T>
 class SkeletonEventTransactor;
 
@@ -29,48 +56,224 @@ class SkeletonEventTransactor<apd::skeleton::EventDispatcher<T>>
   const reactor::Duration deadline;
   apd::Logger& logger;
 
+  // set if the events are sent by a group
+  SkeletonEventGroup* group{nullptr};
+  std::size_t group_index{0};
+  reactor::Input<void>* group_port{nullptr};
+  reactor::ImmutableValuePtr<T> queued_value;
+
+  // metrics
+  TransactorMetrics transactor_metrics{this->fqn()};
+  MetricsRegistration metrics_registration{this->environment(),
+                                           &transactor_metrics};
+
+  // outbound queue, only used if options.queue_depth > 0
+  struct OutboundEvent {
+    MessageContext context;
+    reactor::ImmutableValuePtr<T> value;
+  };
+  const SkeletonEventOptions options;
+  std::deque<OutboundEvent> outbound_queue;
+  std::mutex outbound_mutex;
+  std::condition_variable outbound_cv;
+  std::thread sender_thread;
+  bool running{false};
+  // set while the reactor program was told that the queue is full
+  bool congested{false};
+
+  // actions
+  reactor::StartupAction startup{"startup", this};
+  reactor::ShutdownAction shutdown{"shutdown", this};
+  reactor::PhysicalAction<void> relieved{"relieved", this};
+
   // reactions
-  reactor::Reaction r_notify{"r_notify", 1, this, [this]() { on_notify(); }};
+  reactor::Reaction r_startup{"r_startup", 1, this, [this]() { start(); }};
+  reactor::Reaction r_notify{"r_notify", 2, this, [this]() { on_notify(); }};
+  reactor::Reaction r_relieved{"r_relieved", 3, this,
+                               [this]() { backpressure.set(false); }};
+  reactor::Reaction r_shutdown{"r_shutdown", 4, this, [this]() { stop(); }};
 
   // reaction bodies
   void on_notify() {
     auto x = notify.get();
-    TimeContext::provide_timestamp(this->get_logical_time() + deadline);
-    event->Send(*x);
-    TimeContext::invalidate_timestamp();
+    if (group != nullptr) {
+      queued_value = std::move(x);
+      group->queue(group_index);
+      queued.set();
+      return;
+    }
+
+    MessageContext context{this->get_logical_time() + deadline};
+    if (options.queue_depth > 0) {
+      enqueue(OutboundEvent{context, std::move(x)});
+      return;
+    }
+
+    // Send() takes a reference, so the value is handed to the binding for
+    // serialization without being copied
+    send_event(*event, *x, context);
+    TransactorMetrics::increment(transactor_metrics.messages_sent);
+  }
+
+  void enqueue(OutboundEvent&& outbound) {
+    bool full;
+    bool report = false;
+    {
+      std::lock_guard<std::mutex> lock(outbound_mutex);
+      full = outbound_queue.size() >= options.queue_depth;
+      if (!full) {
+        outbound_queue.push_back(std::move(outbound));
+      } else {
+        if (options.policy == SendQueuePolicy::kDropOldest) {
+          outbound_queue.pop_front();
+          outbound_queue.push_back(std::move(outbound));
+        }
+        report = !congested;
+        congested = true;
+      }
+    }
+
+    if (full) {
+      TransactorMetrics::increment(transactor_metrics.dropped_messages);
+      logger.LogWarn() << "Dropping an event as the outbound queue is full";
+      if (report) {
+        backpressure.set(true);
+      }
+    } else {
+      outbound_cv.notify_one();
+    }
+  }
+
+  void start() {
+    if (options.queue_depth == 0) {
+      return;
+    }
+    running = true;
+    sender_thread = std::thread([this]() { send_events(); });
+  }
+
+  void stop() {
+    {
+      std::lock_guard<std::mutex> lock(outbound_mutex);
+      running = false;
+    }
+    outbound_cv.notify_one();
+    if (sender_thread.joinable()) {
+      sender_thread.join();
+    }
+  }
+
+  void send_events() {
+    std::unique_lock<std::mutex> lock(outbound_mutex);
+    while (true) {
+      outbound_cv.wait(lock, [this]() {
+        return !running || !outbound_queue.empty();
+      });
+      if (!running) {
+        return;
+      }
+
+      auto outbound = std::move(outbound_queue.front());
+      outbound_queue.pop_front();
+      // the reactor program may continue once half of the queue is free
+      bool relieve =
+          congested && outbound_queue.size() <= options.queue_depth / 2;
+      if (relieve) {
+        congested = false;
+      }
+      lock.unlock();
+
+      if (relieve) {
+        relieved.schedule();
+      }
+
+      if (options.policy == SendQueuePolicy::kDropStale &&
+          reactor::get_physical_time() > outbound.context.timestamp) {
+        TransactorMetrics::increment(transactor_metrics.dropped_messages);
+      } else {
+        send_event(*event, *outbound.value, outbound.context);
+        TransactorMetrics::increment(transactor_metrics.messages_sent);
+      }
+
+      lock.lock();
+    }
   }
 
  public:
   // ports
   reactor::Input<T> notify{"notify", this};
+  // only used when the transactor is part of a group
+  reactor::Output<void> queued{"queued", this};
+  // Set to true once an event was dropped as the outbound queue is full and
+  // to false once the queue drained to half of its depth again.
+  reactor::Output<bool> backpressure{"backpressure", this};
 
   SkeletonEventTransactor(const std::string& name,
                           reactor::Environment* env,
                           Event* event,
-                          reactor::Duration deadline)
+                          reactor::Duration deadline,
+                          const SkeletonEventOptions& options = {})
       : reactor::Reactor(name, env)
       , event(event)
       , deadline(deadline)
       , logger(apd::CreateLogger(name.c_str(),
                                  name.c_str(),
-                                 ara::log::LogLevel::kDebug)) {}
+                                 ara::log::LogLevel::kDebug))
+      , options(options) {}
 
   SkeletonEventTransactor(const std::string& name,
                           reactor::Reactor* container,
                           Event* event,
-                          reactor::Duration deadline)
+                          reactor::Duration deadline,
+                          const SkeletonEventOptions& options = {})
       : reactor::Reactor(name, container)
       , event(event)
       , deadline(deadline)
       , logger(apd::CreateLogger(name.c_str(),
                                  name.c_str(),
-                                 ara::log::LogLevel::kDebug)) {}
+                                 ara::log::LogLevel::kDebug))
+      , options(options) {}
+
+  ~SkeletonEventTransactor() { stop(); }
+
+  // Lets the given group send the events of this transactor together with the
+  // events of the other group members. The timestamp is then derived from
+  // the group's deadline. The group needs to have the same container as the
+  // transactor. Must be called while the reactors are constructed, i.e.,
+  // before the environment is assembled. The transactor binds itself to the
+  // group in assemble().
+  void join(SkeletonEventGroup* group) {
+    this->group = group;
+    auto member = group->add_member([this]() {
+      // called by the group within its timestamp context
+      event->Send(*queued_value);
+      queued_value = reactor::ImmutableValuePtr<T>{};
+    });
+    group_index = member.first;
+    group_port = member.second;
+  }
 
   void assemble() override {
+    if (group != nullptr) {
+      queued.bind_to(group_port);
+    }
+    r_startup.declare_trigger(&startup);
     r_notify.declare_trigger(&notify);
-    r_notify.set_deadline(
-        deadline, [this]() { logger.LogError() << "Missed the deadline!"; });
+    r_notify.declare_antidependency(&queued);
+    r_notify.declare_antidependency(&backpressure);
+    r_relieved.declare_trigger(&relieved);
+    r_relieved.declare_antidependency(&backpressure);
+    r_shutdown.declare_trigger(&shutdown);
+    r_notify.set_deadline(deadline, [this]() {
+      auto count =
+          TransactorMetrics::increment(transactor_metrics.deadline_misses);
+      if (TransactorMetrics::should_log(count)) {
+        logger.LogError() << "Missed the deadline! (" << count << " in total)";
+      }
+    });
   }
+
+  const TransactorMetrics& metrics() const { return transactor_metrics; }
 };
 
 }  // namespace dear
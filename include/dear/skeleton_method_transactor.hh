@@ -8,14 +8,75 @@
 
 #pragma once
 
-namespace dear {
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
 
 #include <reactor-cpp/reactor-cpp.hh>
 
 #include "dear/apd_dependencies.hh"
+#include "dear/bound_calibration.hh"
+#include "dear/criticality.hh"
+#include "dear/ingress_queue.hh"
+#include "dear/message_context.hh"
+#include "dear/metrics.hh"
+#include "dear/object_pool.hh"
+#include "dear/pending_request_queue.hh"
 #include "dear/time_context.hh"
 #include "dear/type_traits.hh"
 
+namespace dear {
+
+struct SkeletonMethodOptions {
+  // Number of requests that can be in flight without allocating request data
+  // on the heap.
+  std::size_t request_pool_capacity{64};
+  // Maximum number of requests that were received but not yet answered.
+  // Further requests are rejected.
+  std::size_t max_pending_requests{64};
+  // Calibration of the network delay and synchronization error bounds.
+  CalibrationOptions calibration;
+  // Number of handler reactors that serve requests in parallel. If non-zero,
+  // requests are handed out via the handler_request ports instead of the
+  // request port, each carrying an id that the handler returns with its
+  // response via the corresponding handler_response port.
+  std::size_t handlers{0};
+  // Only used with handlers. If non-zero, release tags are rounded up to a
+  // multiple of this duration, so that requests arriving close to each other
+  // are released at the same tag and handled in parallel.
+  reactor::Duration release_quantum{reactor::Duration::zero()};
+  // Criticality of the service and when to shed its requests under
+  // overload. Shed requests are never answered.
+  SheddingOptions shedding;
+};
+
+// A request handed to one of several handler reactors.
+template <class T>
+struct MethodRequest {
+  std::uint64_t id;
+  reactor::ImmutableValuePtr<T> args;
+};
+
+template <>
+struct MethodRequest<void> {
+  std::uint64_t id;
+};
+
+// The response of a handler reactor to the request with the given id.
+template <class R>
+struct MethodResponse {
+  std::uint64_t id;
+  R value;
+};
+
+template <>
+struct MethodResponse<void> {
+  std::uint64_t id;
+};
+
 template <class R, class T>
 struct RequestDataStruct {
   apd::Promise<R> promise;
@@ -48,18 +109,49 @@ class SkeletonMethodTransactor<apd::Future<R> (Service::*)(Args...)>
  public:
   using RequestType = typename get_request_type<Args...>::type;
   using RequestData = RequestDataStruct<R, RequestType>;
+  using HandlerRequest = MethodRequest<RequestType>;
+  using HandlerResponse = MethodResponse<R>;
 
  protected:
+  struct Handler {
+    std::unique_ptr<reactor::Output<HandlerRequest>> request;
+    std::unique_ptr<reactor::Input<HandlerResponse>> response;
+    // the request the handler currently works on, if any
+    RequestData* serving{nullptr};
+    std::uint64_t id{0};
+  };
+
   // reactor state
   reactor::Duration response_deadline;
   reactor::Duration max_network_delay;
   reactor::Duration max_synchronization_error;
   apd::Logger& logger;
-  std::map<reactor::TimePoint, apd::Promise<R>> pending_requests;
+  // Pending requests ordered by the tag at which they are released. With
+  // handlers, requests leave the queue when they are handed to a handler.
+  PendingRequestQueue<RequestData*> pending_requests;
+  const reactor::Duration release_quantum;
+  const SheddingOptions shedding;
+  std::vector<Handler> handlers;
+  std::size_t busy_handlers{0};
+  std::uint64_t next_request_id{0};
+
+  // Request data is kept in a pool and handed over from the communication
+  // threads via the lock-free incoming queue. The receive_request action only
+  // signals that there is something to process and is scheduled once per
+  // burst of requests.
+  ObjectPool<RequestData> request_pool;
+  BoundCalibration bound_calibration;
+
+  // metrics
+  TransactorMetrics transactor_metrics{this->fqn()};
+  MetricsRegistration metrics_registration{this->environment(),
+                                           &transactor_metrics};
+  IngressQueue<RequestData*> incoming_requests;
 
   // actions
-  reactor::PhysicalAction<RequestData> receive_request{"receive_request", this};
+  reactor::PhysicalAction<void> receive_request{"receive_request", this};
   reactor::LogicalAction<RequestType> send_request{"send_request", this};
+  reactor::LogicalAction<void> dispatch{"dispatch", this};
 
   // reactions
   reactor::Reaction r_receive_request{"r_receive_request", 1, this,
@@ -68,28 +160,67 @@ class SkeletonMethodTransactor<apd::Future<R> (Service::*)(Args...)>
                                    [this]() { on_send_request(); }};
   reactor::Reaction r_response{"r_response", 3, this,
                                [this]() { on_response(); }};
+  reactor::Reaction r_dispatch{"r_dispatch", 4, this,
+                               [this]() { on_dispatch(); }};
+  reactor::Reaction r_handler_response{"r_handler_response", 5, this,
+                                       [this]() { on_handler_response(); }};
 
   // reaction bodies
   void on_receive_request() {
-    auto request = receive_request.get();
+    bool shed = shedding.should_shed(reactor::get_physical_time() -
+                                     get_logical_time());
+    incoming_requests.drain([this, shed](RequestData* request) {
+      TransactorMetrics::increment(transactor_metrics.messages_received);
+      if (shed) {
+        TransactorMetrics::increment(transactor_metrics.shed_messages);
+        request_pool.release(request);
+        return;
+      }
 
-    auto t = request->timestamp + max_network_delay + max_synchronization_error;
-    auto lt = get_logical_time();
+      auto lt = get_logical_time();
+      auto t = bound_calibration.release_tag(request->timestamp, lt);
+
+      if (t <= lt) {
+        auto count =
+            TransactorMetrics::increment(transactor_metrics.timing_violations);
+        if (TransactorMetrics::should_log(count)) {
+          logger.LogError() << "Timing violation! Received a message with "
+                               "timestamp in the past! ("
+                            << count << " in total)";
+        }
+        request_pool.release(request);
+        return;
+      }
+
+      if (!handlers.empty()) {
+        enqueue_for_handlers(request, t, lt);
+        return;
+      }
 
-    auto result = pending_requests.insert(
-        std::make_pair(request->timestamp, std::move(request->promise)));
-    assert(result.second);
+      // Requests with identical timestamps (e.g. from different clients)
+      // would be released at the same tag and overwrite each other. Move them
+      // to the next free tag in the order they were received.
+      while (pending_requests.contains(t)) {
+        t += reactor::Duration{1};
+      }
+
+      if (!pending_requests.insert(t, request)) {
+        TransactorMetrics::increment(transactor_metrics.dropped_messages);
+        logger.LogError() << "Dropping a request as there are too many "
+                             "pending requests!";
+        request_pool.release(request);
+        return;
+      }
+      transactor_metrics.slack.record(t - lt);
+      transactor_metrics.pending_requests.store(pending_requests.size(),
+                                                std::memory_order_relaxed);
 
-    if (t > lt) {
       if constexpr (std::is_same<void, RequestType>::value) {
         send_request.schedule(t - lt);
       } else {
         send_request.schedule(std::move(request->args), t - lt);
       }
-    } else {
-      logger.LogError() << "Timing violation! Received a message with "
-                           "timestamp in the past!";
-    }
+    });
   }
 
   void on_send_request() {
@@ -101,15 +232,152 @@ class SkeletonMethodTransactor<apd::Future<R> (Service::*)(Args...)>
   }
 
   void on_response() {
-    dear::TimeContext::provide_timestamp(this->get_logical_time() +
-                                         this->response_deadline);
-    if constexpr (std::is_same<void, R>::value) {
-      this->pending_requests.begin()->second.set_value();
-    } else {
-      this->pending_requests.begin()->second.set_value(*this->response.get());
+    assert(!this->pending_requests.empty());
+    auto request = this->pending_requests.front();
+    {
+      TimestampScope scope{response_context()};
+      if constexpr (std::is_same<void, R>::value) {
+        request->promise.set_value();
+      } else {
+        request->promise.set_value(*this->response.get());
+      }
+    }
+    this->pending_requests.pop_front();
+    request_pool.release(request);
+    TransactorMetrics::increment(transactor_metrics.messages_sent);
+    transactor_metrics.pending_requests.store(pending_requests.size(),
+                                              std::memory_order_relaxed);
+  }
+
+  void enqueue_for_handlers(RequestData* request,
+                            reactor::TimePoint t,
+                            const reactor::TimePoint& lt) {
+    if (release_quantum > reactor::Duration::zero()) {
+      auto remainder = t.time_since_epoch() % release_quantum;
+      if (remainder != reactor::Duration::zero()) {
+        t += release_quantum - remainder;
+      }
+    }
+
+    // Requests with equal tags are released together and handed to the
+    // handlers in the order they were received.
+    if (!pending_requests.insert(t, request)) {
+      TransactorMetrics::increment(transactor_metrics.dropped_messages);
+      logger.LogError() << "Dropping a request as there are too many "
+                           "pending requests!";
+      request_pool.release(request);
+      return;
+    }
+    transactor_metrics.slack.record(t - lt);
+    update_pending_requests();
+    dispatch.schedule(t - lt);
+  }
+
+  // Hands all released requests to idle handlers, starting with the handler
+  // with the lowest index. Requests that find no idle handler wait until a
+  // handler responded.
+  void on_dispatch() {
+    auto lt = get_logical_time();
+    for (auto& handler : handlers) {
+      if (pending_requests.empty() || pending_requests.front_tag() > lt) {
+        break;
+      }
+      if (handler.serving != nullptr) {
+        continue;
+      }
+      auto request = pending_requests.front();
+      pending_requests.pop_front();
+      handler.serving = request;
+      handler.id = next_request_id++;
+      busy_handlers++;
+      if constexpr (std::is_same<void, RequestType>::value) {
+        handler.request->set(HandlerRequest{handler.id});
+      } else {
+        handler.request->set(
+            HandlerRequest{handler.id, std::move(request->args)});
+      }
+    }
+  }
+
+  // Completes the promises of all requests answered at this tag in the order
+  // of their ids.
+  void on_handler_response() {
+    std::vector<Handler*> answered;
+    bool freed = false;
+    for (auto& handler : handlers) {
+      if (!handler.response->is_present()) {
+        continue;
+      }
+      const auto& response = *handler.response->get();
+      if (handler.serving == nullptr) {
+        TransactorMetrics::increment(transactor_metrics.dropped_messages);
+        logger.LogError() << "Dropping a response for request " << response.id
+                          << " from an idle handler!";
+        continue;
+      }
+      if (response.id != handler.id) {
+        // The handler did not answer the request it was handed. Give up the
+        // served request instead of blocking the handler for good. Its
+        // promise is destroyed without a value, so the client's call times
+        // out.
+        TransactorMetrics::increment(transactor_metrics.dropped_messages);
+        logger.LogError() << "Dropping a response for request " << response.id
+                          << " while the handler serves request "
+                          << handler.id << "!";
+        request_pool.release(handler.serving);
+        handler.serving = nullptr;
+        busy_handlers--;
+        freed = true;
+        continue;
+      }
+      answered.push_back(&handler);
+    }
+    std::sort(answered.begin(), answered.end(),
+              [](const Handler* a, const Handler* b) { return a->id < b->id; });
+
+    {
+      TimestampScope scope{response_context()};
+      for (auto handler : answered) {
+        auto request = handler->serving;
+        if constexpr (std::is_same<void, R>::value) {
+          request->promise.set_value();
+        } else {
+          request->promise.set_value(handler->response->get()->value);
+        }
+        handler->serving = nullptr;
+        busy_handlers--;
+        request_pool.release(request);
+      }
+    }
+    TransactorMetrics::increment(transactor_metrics.messages_sent,
+                                 answered.size());
+    update_pending_requests();
+
+    // the freed handlers take over waiting requests in the next microstep
+    if ((freed || !answered.empty()) && !pending_requests.empty()) {
+      dispatch.schedule();
+    }
+  }
+
+  // the context of responses sent at the current tag
+  MessageContext response_context() const {
+    return MessageContext{this->get_logical_time() + response_deadline};
+  }
+
+  void update_pending_requests() {
+    transactor_metrics.pending_requests.store(
+        pending_requests.size() + busy_handlers, std::memory_order_relaxed);
+  }
+
+  void create_handlers(std::size_t count) {
+    for (std::size_t i = 0; i < count; i++) {
+      auto index = std::to_string(i);
+      handlers.push_back(Handler{
+          std::make_unique<reactor::Output<HandlerRequest>>(
+              "handler_request_" + index, this),
+          std::make_unique<reactor::Input<HandlerResponse>>(
+              "handler_response_" + index, this)});
     }
-    dear::TimeContext::invalidate_timestamp();
-    this->pending_requests.erase(this->pending_requests.begin());
   }
 
  public:
@@ -121,27 +389,47 @@ class SkeletonMethodTransactor<apd::Future<R> (Service::*)(Args...)>
                            reactor::Environment* env,
                            reactor::Duration response_deadline,
                            reactor::Duration max_network_delay,
-                           reactor::Duration max_synchronization_error)
+                           reactor::Duration max_synchronization_error,
+                           const SkeletonMethodOptions& options = {})
       : reactor::Reactor(name, env)
       , response_deadline(response_deadline)
       , max_network_delay(max_network_delay)
       , max_synchronization_error(max_synchronization_error)
       , logger(apd::CreateLogger(name.c_str(),
                                  name.c_str(),
-                                 ara::log::LogLevel::kDebug)) {}
+                                 ara::log::LogLevel::kDebug))
+      , pending_requests(options.max_pending_requests)
+      , release_quantum(options.release_quantum)
+      , shedding(options.shedding)
+      , request_pool(options.request_pool_capacity)
+      , bound_calibration(options.calibration,
+                          max_network_delay + max_synchronization_error)
+      , incoming_requests(options.request_pool_capacity) {
+    create_handlers(options.handlers);
+  }
 
   SkeletonMethodTransactor(const std::string& name,
                            reactor::Reactor* container,
                            reactor::Duration response_deadline,
                            reactor::Duration max_network_delay,
-                           reactor::Duration max_synchronization_error)
+                           reactor::Duration max_synchronization_error,
+                           const SkeletonMethodOptions& options = {})
       : reactor::Reactor(name, container)
       , response_deadline(response_deadline)
       , max_network_delay(max_network_delay)
       , max_synchronization_error(max_synchronization_error)
       , logger(apd::CreateLogger(name.c_str(),
                                  name.c_str(),
-                                 ara::log::LogLevel::kDebug)) {}
+                                 ara::log::LogLevel::kDebug))
+      , pending_requests(options.max_pending_requests)
+      , release_quantum(options.release_quantum)
+      , shedding(options.shedding)
+      , request_pool(options.request_pool_capacity)
+      , bound_calibration(options.calibration,
+                          max_network_delay + max_synchronization_error)
+      , incoming_requests(options.request_pool_capacity) {
+    create_handlers(options.handlers);
+  }
 
   void assemble() override {
     r_receive_request.declare_trigger(&receive_request);
@@ -149,25 +437,81 @@ class SkeletonMethodTransactor<apd::Future<R> (Service::*)(Args...)>
     r_send_request.declare_trigger(&send_request);
     r_send_request.declare_antidependency(&request);
     r_response.declare_trigger(&response);
+    if (!handlers.empty()) {
+      r_receive_request.declare_scheduable_action(&dispatch);
+      r_dispatch.declare_trigger(&dispatch);
+      r_handler_response.declare_scheduable_action(&dispatch);
+      for (auto& handler : handlers) {
+        r_dispatch.declare_antidependency(handler.request.get());
+        r_handler_response.declare_trigger(handler.response.get());
+      }
+    }
+  }
+
+  ~SkeletonMethodTransactor() {
+    incoming_requests.drain(
+        [this](RequestData* request) { request_pool.release(request); });
+    pending_requests.for_each(
+        [this](RequestData* request) { request_pool.release(request); });
+    for (auto& handler : handlers) {
+      if (handler.serving != nullptr) {
+        request_pool.release(handler.serving);
+      }
+    }
   }
 
-  // This is called asynchronously to indicate a new request
+  const BoundCalibration& calibration() const { return bound_calibration; }
+  const TransactorMetrics& metrics() const { return transactor_metrics; }
+
+  // Ports of the handler reactors, if the transactor was configured with
+  // handlers. Handler i receives requests via handler_request(i) and needs to
+  // respond via handler_response(i).
+  std::size_t num_handlers() const { return handlers.size(); }
+  reactor::Output<HandlerRequest>& handler_request(std::size_t index) {
+    return *handlers[index].request;
+  }
+  reactor::Input<HandlerResponse>& handler_response(std::size_t index) {
+    return *handlers[index].response;
+  }
+
+  // largest number of requests that were pending at the same time
+  std::size_t pending_requests_high_water_mark() const {
+    return pending_requests.high_water_mark();
+  }
+
+  // number of requests whose data did not fit into the request pool and was
+  // allocated on the heap instead
+  std::size_t request_pool_heap_allocations() const {
+    return request_pool.heap_allocations();
+  }
+
+  // This is called asynchronously to indicate a new request. The request data
+  // is taken from the pool. The following heap allocations remain per request
+  // and are outside of this transactor's control:
+  //  - the shared state of the promise (APD)
+  //  - the value holding the arguments, as reactor-cpp cannot construct an
+  //    ImmutableValuePtr in preallocated storage. Copying the arguments into
+  //    it may allocate as well, depending on their type.
+  //  - the event queue entry of receive_request, once per burst of requests,
+  //    and of send_request when the request is released (reactor-cpp)
   apd::Future<R> process_request(Args&&... args) {
     apd::Promise<R> promise;
     auto future = promise.get_future();
 
     auto timestamp = TimeContext::retrieve_timestamp();
     assert(timestamp.HasValue());
+    RequestData* value;
     if constexpr (std::is_same<void, RequestType>::value) {
-      auto value = reactor::make_immutable_value<RequestData>(
-          std::move(promise), timestamp.Value());
-      receive_request.schedule(std::move(value));
+      value = request_pool.acquire(std::move(promise), timestamp.Value());
     } else {
       auto request = reactor::make_immutable_value<RequestType>(
           std::forward<Args>(args)...);
-      auto value = reactor::make_immutable_value<RequestData>(
-          std::move(promise), std::move(request), timestamp.Value());
-      receive_request.schedule(std::move(value));
+      value = request_pool.acquire(std::move(promise), std::move(request),
+                                   timestamp.Value());
+    }
+
+    if (incoming_requests.push(value)) {
+      receive_request.schedule();
     }
     return future;
   }
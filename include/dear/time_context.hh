@@ -9,7 +9,9 @@
 #pragma once
 
 #include <cassert>
+#include <cstdint>
 #include <utility>
+#include <vector>
 
 #include <reactor-cpp/logical_time.hh>
 
@@ -17,11 +19,96 @@
 
 namespace dear {
 
+class TimestampScope;
+
+// Maps sample addresses to timestamps using open addressing with linear
+// probing. An entry for an address that is already in the table replaces the
+// old one, as the memory of a sample that was dropped from the cache may be
+// reused for a newer one. Entries are only valid in the generation they were
+// inserted in, so clear() does not touch the slots.
+class SampleTimestampTable {
+private:
+  struct Slot {
+    const void *sample{nullptr};
+    reactor::TimePoint timestamp{};
+    std::uint64_t generation{0};
+  };
+
+  std::vector<Slot> slots;
+  std::size_t size_{0};
+  std::uint64_t generation{1};
+
+  std::size_t index(const void *sample) const {
+    // Fibonacci hashing, as sample addresses share their low bits
+    auto bits = static_cast<std::uint64_t>(
+        reinterpret_cast<std::uintptr_t>(sample));
+    return static_cast<std::size_t>((bits * 0x9e3779b97f4a7c15ull) >> 32) &
+           (slots.size() - 1);
+  }
+
+  bool live(const Slot &slot) const { return slot.generation == generation; }
+
+  void grow() {
+    std::vector<Slot> old(slots.empty() ? 64 : slots.size() * 2);
+    std::swap(old, slots);
+    size_ = 0;
+    for (const auto &slot : old) {
+      if (slot.generation == generation) {
+        insert(slot.sample, slot.timestamp);
+      }
+    }
+  }
+
+public:
+  void insert(const void *sample, const reactor::TimePoint &timestamp) {
+    // keep the load factor at or below one half
+    if (2 * (size_ + 1) > slots.size()) {
+      grow();
+    }
+    auto i = index(sample);
+    while (live(slots[i]) && slots[i].sample != sample) {
+      i = (i + 1) & (slots.size() - 1);
+    }
+    if (!live(slots[i])) {
+      size_++;
+    }
+    slots[i] = Slot{sample, timestamp, generation};
+  }
+
+  const reactor::TimePoint *find(const void *sample) const {
+    if (size_ == 0) {
+      return nullptr;
+    }
+    auto i = index(sample);
+    while (live(slots[i])) {
+      if (slots[i].sample == sample) {
+        return &slots[i].timestamp;
+      }
+      i = (i + 1) & (slots.size() - 1);
+    }
+    return nullptr;
+  }
+
+  void clear() {
+    generation++;
+    size_ = 0;
+  }
+};
+
+// Passes timestamps to and from the binding. The binding reads the timestamp
+// of an outgoing message on the thread that hands the message to it. Prefer a
+// TimestampScope (dear/message_context.hh) over provide_timestamp() and
+// invalidate_timestamp(), as scopes can be nested and are bound to an
+// explicit MessageContext rather than to the reaction that sends.
 class TimeContext {
 private:
+  friend class TimestampScope;
+
   static thread_local bool valid;
   static thread_local reactor::TimePoint timestamp;
 
+  static thread_local SampleTimestampTable sample_timestamps;
+
 public:
   static void provide_timestamp(const reactor::TimePoint &t) {
     assert(!valid);
@@ -42,6 +129,27 @@ public:
     assert(valid);
     valid = false;
   }
+
+  // Attaches a timestamp to an individual sample. This allows the binding to
+  // provide the timestamp of each sample it deserializes during an event
+  // update, instead of a single timestamp for the whole update. Both calls
+  // take constant time.
+  static void provide_sample_timestamp(const void *sample,
+                                       const reactor::TimePoint &t) {
+    sample_timestamps.insert(sample, t);
+  }
+
+  static apd::Result<reactor::TimePoint, bool>
+  retrieve_sample_timestamp(const void *sample) {
+    using Result = apd::Result<reactor::TimePoint, bool>;
+    auto timestamp = sample_timestamps.find(sample);
+    if (timestamp != nullptr) {
+      return Result::FromValue(*timestamp);
+    }
+    return Result::FromError(false);
+  }
+
+  static void invalidate_sample_timestamps() { sample_timestamps.clear(); }
 };
 
 } // namespace dear
@@ -0,0 +1,112 @@
+/*
+ * Copyright (C) 2020 TU Dresden
+ * All rights reserved.
+ *
+ * Authors:
+ *   Christian Menard
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <reactor-cpp/time.hh>
+
+namespace dear {
+
+// A record of a message that a transactor received from the network.
+struct TraceRecord {
+  std::uint32_t transactor_id;
+  // timestamp attached by the sender
+  reactor::TimePoint timestamp;
+  // physical time at which the message arrived
+  reactor::TimePoint arrival;
+  // serialized payload, only valid while the trace is open
+  const void* data;
+  std::size_t size;
+};
+
+// Appends records to a memory-mapped binary trace file. The file is mapped
+// with a fixed capacity upfront, so that appending a record only reserves
+// space with an atomic increment and copies the record into the mapping.
+// Records that do not fit anymore are dropped and counted. Appending is
+// lock-free and may happen from any thread.
+//
+// Each transactor that records into the trace registers with its fully
+// qualified name and receives a small id that is stored in its records.
+class TraceWriter {
+ private:
+  std::string path_;
+  std::uint8_t* data{nullptr};
+  std::size_t capacity_;
+  std::atomic<std::size_t> tail;
+  std::atomic<std::uint64_t> dropped_records_{0};
+
+  std::mutex names_mutex;
+  std::vector<std::string> names;
+
+  bool append(std::uint16_t kind,
+              std::uint32_t transactor_id,
+              const reactor::TimePoint& timestamp,
+              const reactor::TimePoint& arrival,
+              const void* payload,
+              std::size_t size);
+
+ public:
+  // Creates (or truncates) the trace file at path. capacity is the maximum
+  // size of the trace in bytes.
+  TraceWriter(const std::string& path, std::size_t capacity = 1ul << 30);
+  // Truncates the file to the recorded size and unmaps it.
+  ~TraceWriter();
+
+  TraceWriter(const TraceWriter&) = delete;
+  TraceWriter& operator=(const TraceWriter&) = delete;
+
+  std::uint32_t register_transactor(const std::string& name);
+
+  // Returns false if the record was dropped as the trace is full.
+  bool record(std::uint32_t transactor_id,
+              const reactor::TimePoint& timestamp,
+              const reactor::TimePoint& arrival,
+              const void* payload,
+              std::size_t size) {
+    return append(kMessage, transactor_id, timestamp, arrival, payload, size);
+  }
+
+  std::uint64_t dropped_records() const {
+    return dropped_records_.load(std::memory_order_relaxed);
+  }
+  const std::string& path() const { return path_; }
+
+  static constexpr std::uint16_t kMessage = 1;
+  static constexpr std::uint16_t kTransactor = 2;
+};
+
+// Reads a trace file written by TraceWriter.
+class TraceReader {
+ private:
+  const std::uint8_t* data{nullptr};
+  std::size_t size{0};
+  std::vector<std::string> names;
+  std::vector<TraceRecord> records_;
+
+ public:
+  explicit TraceReader(const std::string& path);
+  ~TraceReader();
+
+  TraceReader(const TraceReader&) = delete;
+  TraceReader& operator=(const TraceReader&) = delete;
+
+  // message records in the order they were appended
+  const std::vector<TraceRecord>& records() const { return records_; }
+
+  // fully qualified names of the recording transactors indexed by their id
+  const std::vector<std::string>& transactors() const { return names; }
+};
+
+}  // namespace dear
@@ -0,0 +1,114 @@
+/*
+ * Copyright (C) 2020 TU Dresden
+ * All rights reserved.
+ *
+ * Authors:
+ *   Christian Menard
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <functional>
+#include <map>
+#include <string>
+#include <thread>
+
+#include <reactor-cpp/reactor-cpp.hh>
+
+#include "dear/codec.hh"
+#include "dear/trace.hh"
+
+namespace dear {
+
+enum class ReplayPace {
+  // inject messages with the same spacing as they originally arrived
+  kOriginal,
+  // inject all messages right away
+  kAsFastAsPossible,
+};
+
+// Feeds the messages of a recorded trace back into transactors. Replayed
+// messages enter a transactor via its inject() method, i.e., through a
+// physical action just like messages from the network, and are released at
+// the same tags relative to each other as in the original run.
+//
+// All timestamps are shifted by the difference between the start of the
+// replay and the arrival of the first recorded message. Otherwise, all
+// messages would be considered late.
+class TraceReplay {
+ public:
+  using Injector = std::function<
+      void(const reactor::TimePoint& timestamp, const void* data, size_t size)>;
+
+ private:
+  TraceReader reader;
+  std::map<std::string, Injector> injectors;
+  std::atomic<bool> stopped{false};
+
+ public:
+  explicit TraceReplay(const std::string& path) : reader(path) {}
+
+  // Replays the messages recorded by the transactor with the given fully
+  // qualified name via the given injector.
+  void attach(const std::string& name, Injector injector) {
+    injectors[name] = std::move(injector);
+  }
+
+  // Replays the messages recorded by the given transactor into it.
+  template <class Transactor>
+  void attach(Transactor& transactor) {
+    using T = typename Transactor::ValueType;
+    attach(transactor.fqn(),
+           [&transactor](const reactor::TimePoint& timestamp, const void* data,
+                         size_t size) {
+             transactor.inject(timestamp, Codec<T>::decode(data, size));
+           });
+  }
+
+  // Replays the trace. This blocks until all messages were injected or
+  // stop() was called and should run in its own thread while the environment
+  // is running. Returns the number of injected messages. Messages of
+  // transactors that were not attached are skipped.
+  std::size_t run(ReplayPace pace) {
+    const auto& records = reader.records();
+    if (records.empty()) {
+      return 0;
+    }
+
+    // resolve the injector of each transactor id once
+    std::vector<const Injector*> by_id(reader.transactors().size(), nullptr);
+    for (std::size_t i = 0; i < by_id.size(); i++) {
+      auto it = injectors.find(reader.transactors()[i]);
+      if (it != injectors.end()) {
+        by_id[i] = &it->second;
+      }
+    }
+
+    auto offset = reactor::Reactor::get_physical_time() - records[0].arrival;
+    std::size_t injected = 0;
+    for (const auto& record : records) {
+      if (stopped.load(std::memory_order_relaxed)) {
+        break;
+      }
+      if (record.transactor_id >= by_id.size() ||
+          by_id[record.transactor_id] == nullptr) {
+        continue;
+      }
+      if (pace == ReplayPace::kOriginal) {
+        std::this_thread::sleep_until(record.arrival + offset);
+      }
+      (*by_id[record.transactor_id])(record.timestamp + offset, record.data,
+                                     record.size);
+      injected++;
+    }
+    return injected;
+  }
+
+  void stop() { stopped.store(true, std::memory_order_relaxed); }
+
+  const TraceReader& trace() const { return reader; }
+};
+
+}  // namespace dear
@@ -9,12 +9,95 @@
 #pragma once
 
 #include <reactor-cpp/time.hh>
+#include <cstdint>
 #include <type_traits>
+#include <vector>
 
 #include "dear/apd_dependencies.hh"
 
 namespace dear {
 
+// Layout of the fixed size timestamp trailer that the binding appends to the
+// payload:
+//
+//   [ serialized arguments ... | time_ns (8) | check (4) | magic (4) ]
+//
+// All fields are stored in big endian byte order like the rest of a SOME/IP
+// payload. The magic word encodes the trailer version and allows to read the
+// timestamp without knowing anything about the arguments in front of it. The
+// check word is computed by check_word() from the timestamp. It keeps a
+// legacy payload that happens to end with the magic word from being taken
+// for a trailer.
+namespace trailer {
+constexpr std::uint32_t kMagic = 0x44454102;  // "DEA" + version 2
+constexpr std::size_t kTimestampSize = sizeof(reactor::Duration::rep);
+constexpr std::size_t kCheckSize = sizeof(std::uint32_t);
+constexpr std::size_t kMagicSize = sizeof(kMagic);
+constexpr std::size_t kSize = kTimestampSize + kCheckSize + kMagicSize;
+
+constexpr std::uint32_t check_word(reactor::Duration::rep time_ns) {
+  auto bits = static_cast<std::uint64_t>(time_ns);
+  return static_cast<std::uint32_t>(bits >> 32) ^
+         static_cast<std::uint32_t>(bits) ^ ~kMagic;
+}
+}  // namespace trailer
+
+namespace internal {
+
+template <class T>
+T load_big_endian(const ::vsomeip::byte_t* data) {
+  using U = typename std::make_unsigned<T>::type;
+  U value = 0;
+  for (std::size_t i = 0; i < sizeof(T); i++) {
+    value = static_cast<U>(value << 8) | static_cast<U>(data[i]);
+  }
+  return static_cast<T>(value);
+}
+
+template <class T>
+void store_big_endian(T value, ::vsomeip::byte_t* data) {
+  using U = typename std::make_unsigned<T>::type;
+  U v = static_cast<U>(value);
+  for (std::size_t i = sizeof(T); i > 0; i--) {
+    data[i - 1] = static_cast<::vsomeip::byte_t>(v & 0xff);
+    v = static_cast<U>(v >> 8);
+  }
+}
+
+}  // namespace internal
+
+// Appends the fixed size timestamp trailer to an already serialized payload.
+inline void append_timestamp_trailer(std::vector<::vsomeip::byte_t>& buffer,
+                                     const reactor::TimePoint& timestamp) {
+  auto time_ns = timestamp.time_since_epoch().count();
+  auto offset = buffer.size();
+  buffer.resize(offset + trailer::kSize);
+  auto data = buffer.data() + offset;
+  internal::store_big_endian<reactor::Duration::rep>(time_ns, data);
+  internal::store_big_endian<std::uint32_t>(trailer::check_word(time_ns),
+                                            data + trailer::kTimestampSize);
+  internal::store_big_endian<std::uint32_t>(
+      trailer::kMagic, data + trailer::kTimestampSize + trailer::kCheckSize);
+}
+
+// Serialized size of types whose SOME/IP representation does not depend on
+// their value. Only scalar types qualify by default. Specialize this for
+// structs of scalars if the serializer does not insert any padding or length
+// fields for them.
+template <class T, class Enable = void>
+struct fixed_serialized_size {
+  static constexpr bool value = false;
+  static constexpr std::size_t size = 0;
+};
+
+template <class T>
+struct fixed_serialized_size<
+    T,
+    std::enable_if_t<std::is_arithmetic<T>::value || std::is_enum<T>::value>> {
+  static constexpr bool value = true;
+  static constexpr std::size_t size = sizeof(T);
+};
+
 namespace internal {
 
 template <class... T>
@@ -22,24 +105,40 @@ struct _message_size;
 
 template <class Head, class... Tail>
 struct _message_size<Head, Tail...> {
+  // XXX I have no clue why this is required... Somewhere const& gets added
+  // to the type and we need to remove it ....
+  using base_type = typename std::remove_cv<
+      typename std::remove_reference<Head>::type>::type;
+
+  // true if the serialized size of all arguments is known at compile time
+  static constexpr bool is_fixed = fixed_serialized_size<base_type>::value &&
+                                   _message_size<Tail...>::is_fixed;
+  static constexpr size_t fixed_size = fixed_serialized_size<base_type>::size +
+                                      _message_size<Tail...>::fixed_size;
+
   static size_t size(const std::shared_ptr<::vsomeip::message>& message,
                      size_t offset) {
-    // XXX I have no clue why this is required... Somewhere const& gets added
-    // to the type and we need to remove it ....
-    using base_type = typename std::remove_cv<
-        typename std::remove_reference<Head>::type>::type;
-    const ::vsomeip::payload& payload = *message->get_payload();
-    apd::Deserializer<base_type> deserializer(payload.get_data() + offset,
-                                              payload.get_length() - offset);
-
-    offset += deserializer.getSize();
-    return _message_size<Tail...>::size(message, offset);
+    if constexpr (fixed_serialized_size<base_type>::value) {
+      // skip fixed size arguments without deserializing them
+      return _message_size<Tail...>::size(
+          message, offset + fixed_serialized_size<base_type>::size);
+    } else {
+      const ::vsomeip::payload& payload = *message->get_payload();
+      apd::Deserializer<base_type> deserializer(payload.get_data() + offset,
+                                                payload.get_length() - offset);
+
+      offset += deserializer.getSize();
+      return _message_size<Tail...>::size(message, offset);
+    }
   }
 };
 
 template <>
 struct _message_size<> {
-  static size_t size(const std::shared_ptr<::vsomeip::message>& message,
+  static constexpr bool is_fixed = true;
+  static constexpr size_t fixed_size = 0;
+
+  static size_t size(const std::shared_ptr<::vsomeip::message>&,
                      size_t offset) {
     return offset;
   }
@@ -52,24 +151,78 @@ uint64_t get_message_size(const std::shared_ptr<::vsomeip::message>& message) {
   return internal::_message_size<T...>::size(message, 0);
 }
 
+// Reads the timestamp from the fixed size trailer in O(1). Returns an error if
+// the payload does not end with a valid trailer.
+inline apd::Result<reactor::TimePoint, bool> get_timestamp_from_trailer(
+    const ::vsomeip::payload& payload) {
+  using Result = apd::Result<reactor::TimePoint, bool>;
+
+  size_t length = payload.get_length();
+  if (length < trailer::kSize) {
+    return Result::FromError(false);
+  }
+
+  const ::vsomeip::byte_t* data = payload.get_data() + length - trailer::kSize;
+  auto magic = internal::load_big_endian<std::uint32_t>(
+      data + trailer::kTimestampSize + trailer::kCheckSize);
+  if (magic != trailer::kMagic) {
+    return Result::FromError(false);
+  }
+
+  auto time_ns = internal::load_big_endian<reactor::Duration::rep>(data);
+  auto check =
+      internal::load_big_endian<std::uint32_t>(data + trailer::kTimestampSize);
+  if (check != trailer::check_word(time_ns)) {
+    return Result::FromError(false);
+  }
+  return Result::FromValue(reactor::TimePoint{reactor::Duration{time_ns}});
+}
+
+// Reads the timestamp attached to a message. Messages carrying the fixed size
+// trailer are handled without touching the arguments. Otherwise, this falls
+// back to the legacy format where the timestamp is serialized right after the
+// arguments, which requires deserializing all of them.
 template <class... Args>
 apd::Result<reactor::TimePoint, bool> get_timestamp_from_message(
     const std::shared_ptr<::vsomeip::message>& message) {
   using Result = apd::Result<reactor::TimePoint, bool>;
 
   size_t payload_size = message->get_payload()->get_length();
-  size_t message_size = get_message_size<Args...>(message);
-
-  // check if there is a timestamp attached
-  if (payload_size == sizeof(reactor::Duration::rep) + message_size) {
-    apd::Unmarshaller<Args..., reactor::Duration::rep> unmarshaller(*message);
-    reactor::Duration::rep time_ns =
-        unmarshaller.template unmarshal<sizeof...(Args)>();
-    reactor::TimePoint timestamp{reactor::Duration{time_ns}};
-    return Result::FromValue(timestamp);
-  }
 
-  return Result::FromError(false);
+  if constexpr (internal::_message_size<Args...>::is_fixed) {
+    // The offset of the timestamp is a compile time constant and it can be
+    // loaded directly. The payload size tells which format is used.
+    constexpr size_t message_size =
+        internal::_message_size<Args...>::fixed_size;
+    if (payload_size == message_size + trailer::kSize) {
+      return get_timestamp_from_trailer(*message->get_payload());
+    }
+    if (payload_size == sizeof(reactor::Duration::rep) + message_size) {
+      auto time_ns = internal::load_big_endian<reactor::Duration::rep>(
+          message->get_payload()->get_data() + message_size);
+      return Result::FromValue(reactor::TimePoint{reactor::Duration{time_ns}});
+    }
+    return Result::FromError(false);
+  } else {
+    auto trailer_timestamp =
+        get_timestamp_from_trailer(*message->get_payload());
+    if (trailer_timestamp.HasValue()) {
+      return trailer_timestamp;
+    }
+
+    size_t message_size = get_message_size<Args...>(message);
+
+    // check if there is a timestamp attached
+    if (payload_size == sizeof(reactor::Duration::rep) + message_size) {
+      apd::Unmarshaller<Args..., reactor::Duration::rep> unmarshaller(*message);
+      reactor::Duration::rep time_ns =
+          unmarshaller.template unmarshal<sizeof...(Args)>();
+      reactor::TimePoint timestamp{reactor::Duration{time_ns}};
+      return Result::FromValue(timestamp);
+    }
+
+    return Result::FromError(false);
+  }
 }
 
 }  // namespace dear
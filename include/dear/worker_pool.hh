@@ -0,0 +1,48 @@
+/*
+ * Copyright (C) 2020 TU Dresden
+ * All rights reserved.
+ *
+ * Authors:
+ *   Christian Menard
+ */
+
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace dear {
+
+// A fixed set of threads that run submitted jobs in the order they were
+// submitted. Transactors use it to move work off the reactor worker threads.
+// A single pool is typically shared by all transactors of a program.
+class WorkerPool {
+ private:
+  std::mutex mutex;
+  std::condition_variable cv;
+  std::deque<std::function<void()>> jobs;
+  bool stopped{false};
+  std::vector<std::thread> threads;
+
+  void run();
+
+ public:
+  explicit WorkerPool(std::size_t num_threads);
+  // Runs all jobs that are still queued before the threads are joined.
+  ~WorkerPool();
+
+  WorkerPool(const WorkerPool&) = delete;
+  WorkerPool& operator=(const WorkerPool&) = delete;
+
+  // May be called from any thread.
+  void submit(std::function<void()> job);
+
+  std::size_t size() const { return threads.size(); }
+};
+
+}  // namespace dear
@@ -0,0 +1,168 @@
+/*
+ * Copyright (C) 2020 TU Dresden
+ * All rights reserved.
+ *
+ * Authors:
+ *   Christian Menard
+ */
+
+#include "dear/delta_codec.hh"
+
+#include <algorithm>
+#include <cstring>
+
+namespace dear {
+
+// Message layout:
+//
+//   [ header | range header | bytes | range header | bytes | ... ]
+//
+// A delta applies to the state with sequence number base and turns it into
+// the state with sequence number base + 1. Keyframes apply to any state.
+namespace {
+
+constexpr std::uint16_t kKeyframe = 1;
+
+struct Header {
+  std::uint64_t base;
+  std::uint32_t state_size;
+  std::uint32_t range_count;
+  std::uint16_t flags;
+  std::uint16_t reserved[3];
+};
+
+struct RangeHeader {
+  std::uint32_t offset;
+  std::uint32_t length;
+};
+
+void append(std::vector<std::uint8_t>& out,
+            const void* data,
+            std::size_t size) {
+  auto bytes = static_cast<const std::uint8_t*>(data);
+  out.insert(out.end(), bytes, bytes + size);
+}
+
+}  // namespace
+
+DeltaEncoder::DeltaEncoder(const DeltaOptions& options) : options(options) {}
+
+bool DeltaEncoder::encode(const void* state,
+                          std::size_t size,
+                          std::vector<std::uint8_t>& out) {
+  auto bytes = static_cast<const std::uint8_t*>(state);
+  auto block_size = std::max<std::size_t>(options.block_size, 1);
+
+  bool keyframe = keyframe_requested || size != last_state.size() ||
+                  (options.keyframe_interval > 0 &&
+                   since_keyframe + 1 >= options.keyframe_interval);
+
+  out.clear();
+  out.resize(sizeof(Header));
+  std::uint32_t range_count = 0;
+
+  if (!keyframe) {
+    std::size_t changed = 0;
+    std::size_t offset = 0;
+    while (offset < size) {
+      auto length = std::min(block_size, size - offset);
+      if (std::memcmp(bytes + offset, last_state.data() + offset, length) ==
+          0) {
+        offset += length;
+        continue;
+      }
+      // extend the range over all adjacent changed blocks
+      auto end = offset + length;
+      while (end < size) {
+        auto next = std::min(block_size, size - end);
+        if (std::memcmp(bytes + end, last_state.data() + end, next) == 0) {
+          break;
+        }
+        end += next;
+      }
+      RangeHeader range{static_cast<std::uint32_t>(offset),
+                        static_cast<std::uint32_t>(end - offset)};
+      append(out, &range, sizeof(range));
+      append(out, bytes + offset, end - offset);
+      std::memcpy(last_state.data() + offset, bytes + offset, end - offset);
+      range_count++;
+      changed += end - offset;
+      offset = end;
+    }
+    // a delta that covers most of the state is not worth it
+    if (changed > size / 2) {
+      keyframe = true;
+      out.resize(sizeof(Header));
+      range_count = 0;
+    }
+  }
+
+  if (keyframe) {
+    RangeHeader range{0, static_cast<std::uint32_t>(size)};
+    append(out, &range, sizeof(range));
+    append(out, bytes, size);
+    last_state.assign(bytes, bytes + size);
+    range_count = 1;
+    since_keyframe = 0;
+    keyframe_requested = false;
+  } else {
+    since_keyframe++;
+  }
+
+  Header header{};
+  header.base = sequence;
+  header.state_size = static_cast<std::uint32_t>(size);
+  header.range_count = range_count;
+  header.flags = keyframe ? kKeyframe : 0;
+  std::memcpy(out.data(), &header, sizeof(header));
+  sequence++;
+  return keyframe;
+}
+
+DeltaDecoder::Status DeltaDecoder::decode(const void* data,
+                                          std::size_t size,
+                                          std::vector<DeltaRange>& ranges) {
+  ranges.clear();
+  if (size < sizeof(Header)) {
+    return Status::kMalformed;
+  }
+  Header header;
+  std::memcpy(&header, data, sizeof(header));
+  bool keyframe = (header.flags & kKeyframe) != 0;
+
+  auto bytes = static_cast<const std::uint8_t*>(data);
+  std::size_t position = sizeof(Header);
+  for (std::uint32_t i = 0; i < header.range_count; i++) {
+    if (size - position < sizeof(RangeHeader)) {
+      return Status::kMalformed;
+    }
+    RangeHeader range;
+    std::memcpy(&range, bytes + position, sizeof(range));
+    position += sizeof(range);
+    if (size - position < range.length ||
+        range.offset > header.state_size ||
+        header.state_size - range.offset < range.length) {
+      return Status::kMalformed;
+    }
+    ranges.push_back(DeltaRange{range.offset, bytes + position, range.length});
+    position += range.length;
+  }
+
+  if (keyframe) {
+    if (ranges.size() != 1 || ranges[0].length != header.state_size) {
+      return Status::kMalformed;
+    }
+  } else if (!synchronized || header.base != sequence ||
+             header.state_size != state_size) {
+    ranges.clear();
+    synchronized = false;
+    return Status::kMissingBase;
+  }
+
+  sequence = header.base + 1;
+  state_size = header.state_size;
+  synchronized = true;
+  return keyframe ? Status::kKeyframe : Status::kDelta;
+}
+
+}  // namespace dear
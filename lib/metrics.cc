@@ -0,0 +1,86 @@
+/*
+ * Copyright (C) 2020 TU Dresden
+ * All rights reserved.
+ *
+ * Authors:
+ *   Christian Menard
+ */
+
+#include "dear/metrics.hh"
+
+#include <algorithm>
+#include <map>
+#include <mutex>
+
+namespace dear {
+
+namespace {
+
+std::mutex registry_mutex;
+std::map<const reactor::Environment*, std::vector<const TransactorMetrics*>>
+    registry;
+
+MetricsSnapshot take_snapshot(const TransactorMetrics& metrics) {
+  MetricsSnapshot snapshot;
+  snapshot.name = metrics.name;
+  snapshot.messages_sent = metrics.messages_sent.load();
+  snapshot.messages_received = metrics.messages_received.load();
+  snapshot.timing_violations = metrics.timing_violations.load();
+  snapshot.deadline_misses = metrics.deadline_misses.load();
+  snapshot.timeouts = metrics.timeouts.load();
+  snapshot.shed_messages = metrics.shed_messages.load();
+  snapshot.dropped_messages = metrics.dropped_messages.load();
+  snapshot.lost_samples = metrics.lost_samples.load();
+  snapshot.pending_requests = metrics.pending_requests.load();
+  snapshot.slack_p1 = metrics.slack.value_at_percentile(0.01);
+  snapshot.slack_p50 = metrics.slack.value_at_percentile(0.5);
+  snapshot.slack_p99 = metrics.slack.value_at_percentile(0.99);
+
+  for (std::size_t i = 0; i < CoarseLatencyHistogram::kBucketCount; i++) {
+    auto count = metrics.slack.bucket_count(i);
+    if (count > 0) {
+      auto upper = CoarseLatencyHistogram::bucket_upper_bound(i);
+      snapshot.slack_histogram.emplace_back(
+          reactor::Duration{static_cast<reactor::Duration::rep>(upper)},
+          count);
+    }
+  }
+  return snapshot;
+}
+
+}  // namespace
+
+MetricsRegistration::MetricsRegistration(
+    const reactor::Environment* environment,
+    const TransactorMetrics* metrics)
+    : environment(environment), metrics(metrics) {
+  std::lock_guard<std::mutex> lock(registry_mutex);
+  registry[environment].push_back(metrics);
+}
+
+MetricsRegistration::~MetricsRegistration() {
+  std::lock_guard<std::mutex> lock(registry_mutex);
+  auto& entries = registry[environment];
+  entries.erase(std::remove(entries.begin(), entries.end(), metrics),
+                entries.end());
+  if (entries.empty()) {
+    registry.erase(environment);
+  }
+}
+
+std::vector<MetricsSnapshot> collect_metrics(
+    const reactor::Environment* environment) {
+  std::vector<MetricsSnapshot> snapshots;
+
+  std::lock_guard<std::mutex> lock(registry_mutex);
+  auto it = registry.find(environment);
+  if (it != registry.end()) {
+    snapshots.reserve(it->second.size());
+    for (auto metrics : it->second) {
+      snapshots.push_back(take_snapshot(*metrics));
+    }
+  }
+  return snapshots;
+}
+
+}  // namespace dear
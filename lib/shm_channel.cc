@@ -0,0 +1,321 @@
+/*
+ * Copyright (C) 2020 TU Dresden
+ * All rights reserved.
+ *
+ * Authors:
+ *   Christian Menard
+ */
+
+#include "dear/shm_channel.hh"
+
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <ctime>
+#include <system_error>
+#include <thread>
+
+#include <fcntl.h>
+#include <signal.h>
+#include <semaphore.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace dear {
+
+namespace {
+
+constexpr std::uint32_t kMagic = 0x44454153;  // "DEAS"
+constexpr std::uint32_t kVersion = 2;
+constexpr std::size_t kCacheLine = 64;
+
+static_assert(std::atomic<std::uint64_t>::is_always_lock_free,
+              "the channel requires address-free 64 bit atomics");
+
+struct SlotHeader {
+  // Sequence number of the slot as in Vyukov's bounded queue. A slot at
+  // position p is free for the producer if sequence == p and holds a message
+  // for the consumer if sequence == p + 1.
+  std::atomic<std::uint64_t> sequence;
+  std::int64_t timestamp;
+  std::uint64_t size;
+};
+
+constexpr std::size_t round_up(std::size_t value, std::size_t alignment) {
+  return (value + alignment - 1) / alignment * alignment;
+}
+
+std::size_t next_power_of_two(std::size_t value) {
+  std::size_t result = 1;
+  while (result < value) {
+    result <<= 1;
+  }
+  return result;
+}
+
+[[noreturn]] void throw_errno(const std::string& what) {
+  throw std::system_error(errno, std::generic_category(), what);
+}
+
+// A consumer claim holds the pid of the consumer's process in the upper and a
+// number unique within that process in the lower 32 bits.
+std::uint64_t next_consumer_claim() {
+  static std::atomic<std::uint32_t> next{1};
+  return static_cast<std::uint64_t>(getpid()) << 32 |
+         next.fetch_add(1, std::memory_order_relaxed);
+}
+
+// Channels release their claim when they are destroyed, so a claim only
+// becomes stale if its process died.
+bool consumer_alive(std::uint64_t claim) {
+  auto pid = static_cast<pid_t>(claim >> 32);
+  return pid == getpid() || kill(pid, 0) == 0 || errno == EPERM;
+}
+
+[[noreturn]] void throw_not_initialized(const std::string& name) {
+  throw std::system_error(std::make_error_code(std::errc::timed_out),
+                          "shared memory channel " + name +
+                              " was not initialized by its creator");
+}
+
+}  // namespace
+
+struct ShmChannel::Header {
+  std::atomic<std::uint32_t> magic;
+  std::uint32_t version;
+  std::uint64_t slot_size;
+  std::uint64_t slot_stride;
+  std::uint64_t capacity;
+  sem_t messages;
+  // claim of the channel that consumes the messages, 0 if there is none
+  std::atomic<std::uint64_t> consumer;
+
+  alignas(kCacheLine) std::atomic<std::uint64_t> enqueue_position;
+  alignas(kCacheLine) std::atomic<std::uint64_t> dequeue_position;
+};
+
+namespace {
+
+constexpr std::size_t kSlotsOffset =
+    round_up(sizeof(ShmChannel::Header), kCacheLine);
+
+}  // namespace
+
+ShmChannel::ShmChannel(const std::string& name,
+                       const ShmChannelOptions& options)
+    : name_(name) {
+  // the creator may die before it initialized the segment
+  auto open_deadline = std::chrono::steady_clock::now() + options.open_timeout;
+  bool created = true;
+  int fd = shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+  if (fd == -1 && errno == EEXIST) {
+    created = false;
+    fd = shm_open(name.c_str(), O_RDWR, 0600);
+  }
+  if (fd == -1) {
+    throw_errno("shm_open " + name);
+  }
+
+  if (created) {
+    auto capacity = next_power_of_two(options.capacity);
+    auto stride =
+        round_up(sizeof(SlotHeader) + options.slot_size, kCacheLine);
+    mapped_size = kSlotsOffset + capacity * stride;
+    if (ftruncate(fd, static_cast<off_t>(mapped_size)) == -1) {
+      close(fd);
+      shm_unlink(name.c_str());
+      throw_errno("ftruncate " + name);
+    }
+  } else {
+    // wait until the creator sized the segment
+    struct stat st;
+    do {
+      if (fstat(fd, &st) == -1) {
+        close(fd);
+        throw_errno("fstat " + name);
+      }
+      if (st.st_size == 0) {
+        if (std::chrono::steady_clock::now() >= open_deadline) {
+          close(fd);
+          throw_not_initialized(name);
+        }
+        std::this_thread::yield();
+      }
+    } while (st.st_size == 0);
+    mapped_size = static_cast<std::size_t>(st.st_size);
+  }
+
+  void* p =
+      mmap(nullptr, mapped_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  if (p == MAP_FAILED) {
+    auto error = errno;
+    close(fd);
+    if (created) {
+      shm_unlink(name.c_str());
+    }
+    throw std::system_error(error, std::generic_category(), "mmap " + name);
+  }
+  close(fd);
+  header = static_cast<Header*>(p);
+
+  if (created) {
+    header->version = kVersion;
+    header->capacity = next_power_of_two(options.capacity);
+    header->slot_size = options.slot_size;
+    header->slot_stride = (mapped_size - kSlotsOffset) / header->capacity;
+    if (sem_init(&header->messages, 1, 0) == -1) {
+      auto error = errno;
+      munmap(header, mapped_size);
+      shm_unlink(name.c_str());
+      throw std::system_error(error, std::generic_category(),
+                              "sem_init " + name);
+    }
+    new (&header->consumer) std::atomic<std::uint64_t>(0);
+    new (&header->enqueue_position) std::atomic<std::uint64_t>(0);
+    new (&header->dequeue_position) std::atomic<std::uint64_t>(0);
+    for (std::uint64_t i = 0; i < header->capacity; i++) {
+      new (slot(i)) SlotHeader{{i}, 0, 0};
+    }
+    header->magic.store(kMagic, std::memory_order_release);
+  } else {
+    // the segment is zero-filled until the creator published the header
+    while (header->magic.load(std::memory_order_acquire) != kMagic) {
+      if (std::chrono::steady_clock::now() >= open_deadline) {
+        munmap(header, mapped_size);
+        throw_not_initialized(name);
+      }
+      std::this_thread::yield();
+    }
+    if (header->version != kVersion) {
+      munmap(header, mapped_size);
+      throw std::system_error(std::make_error_code(std::errc::invalid_argument),
+                              "incompatible shared memory channel " + name);
+    }
+  }
+}
+
+ShmChannel::~ShmChannel() {
+  if (header != nullptr) {
+    if (consumer_claim != 0) {
+      auto claim = consumer_claim;
+      header->consumer.compare_exchange_strong(claim, 0);
+    }
+    munmap(header, mapped_size);
+  }
+}
+
+void ShmChannel::claim_consumer() {
+  if (consumer_claim != 0) {
+    return;
+  }
+  auto claim = next_consumer_claim();
+  auto current = header->consumer.load();
+  do {
+    if (current != 0 && consumer_alive(current)) {
+      throw std::system_error(
+          std::make_error_code(std::errc::device_or_resource_busy),
+          "shared memory channel " + name_ + " already has a consumer");
+    }
+  } while (!header->consumer.compare_exchange_weak(current, claim));
+  consumer_claim = claim;
+}
+
+std::uint8_t* ShmChannel::slot(std::uint64_t position) const {
+  auto index = position & (header->capacity - 1);
+  return reinterpret_cast<std::uint8_t*>(header) + kSlotsOffset +
+         index * header->slot_stride;
+}
+
+bool ShmChannel::try_push(const reactor::TimePoint& timestamp,
+                          const void* data,
+                          std::size_t size) {
+  if (size > header->slot_size) {
+    return false;
+  }
+
+  auto position = header->enqueue_position.load(std::memory_order_relaxed);
+  SlotHeader* s;
+  for (;;) {
+    s = reinterpret_cast<SlotHeader*>(slot(position));
+    auto sequence = s->sequence.load(std::memory_order_acquire);
+    auto diff = static_cast<std::int64_t>(sequence - position);
+    if (diff == 0) {
+      if (header->enqueue_position.compare_exchange_weak(
+              position, position + 1, std::memory_order_relaxed)) {
+        break;
+      }
+    } else if (diff < 0) {
+      // the consumer did not yet free this slot
+      return false;
+    } else {
+      position = header->enqueue_position.load(std::memory_order_relaxed);
+    }
+  }
+
+  s->timestamp = timestamp.time_since_epoch().count();
+  s->size = size;
+  std::memcpy(reinterpret_cast<std::uint8_t*>(s) + sizeof(SlotHeader), data,
+              size);
+  s->sequence.store(position + 1, std::memory_order_release);
+  sem_post(&header->messages);
+  return true;
+}
+
+bool ShmChannel::front(reactor::TimePoint& timestamp,
+                       const void*& data,
+                       std::size_t& size) const {
+  auto position = header->dequeue_position.load(std::memory_order_relaxed);
+  auto s = reinterpret_cast<SlotHeader*>(slot(position));
+  if (s->sequence.load(std::memory_order_acquire) != position + 1) {
+    return false;
+  }
+  timestamp = reactor::TimePoint{reactor::Duration{s->timestamp}};
+  data = reinterpret_cast<const std::uint8_t*>(s) + sizeof(SlotHeader);
+  size = static_cast<std::size_t>(s->size);
+  return true;
+}
+
+void ShmChannel::pop() {
+  auto position = header->dequeue_position.load(std::memory_order_relaxed);
+  auto s = reinterpret_cast<SlotHeader*>(slot(position));
+  s->sequence.store(position + header->capacity, std::memory_order_release);
+  header->dequeue_position.store(position + 1, std::memory_order_relaxed);
+  // Every message posts the semaphore once, but the consumer waits once and
+  // then drains everything. Take the popped message's count, so that the
+  // consumer does not wake up again for messages it already drained. This
+  // fails if wait() already took the count, or if the producer did not post
+  // yet, which leaves at most one spurious wake-up.
+  sem_trywait(&header->messages);
+}
+
+bool ShmChannel::wait(std::chrono::milliseconds timeout) {
+  struct timespec deadline;
+  clock_gettime(CLOCK_REALTIME, &deadline);
+  auto ns = deadline.tv_nsec +
+            std::chrono::duration_cast<std::chrono::nanoseconds>(timeout)
+                .count();
+  deadline.tv_sec += static_cast<time_t>(ns / 1000000000);
+  deadline.tv_nsec = static_cast<long>(ns % 1000000000);
+
+  while (sem_timedwait(&header->messages, &deadline) == -1) {
+    if (errno != EINTR) {
+      return false;
+    }
+  }
+  return true;
+}
+
+std::size_t ShmChannel::slot_size() const {
+  return static_cast<std::size_t>(header->slot_size);
+}
+
+std::size_t ShmChannel::capacity() const {
+  return static_cast<std::size_t>(header->capacity);
+}
+
+void ShmChannel::remove(const std::string& name) {
+  shm_unlink(name.c_str());
+}
+
+}  // namespace dear
@@ -12,5 +12,6 @@ namespace dear {
 
 thread_local reactor::TimePoint TimeContext::timestamp;
 thread_local bool TimeContext::valid = false;
+thread_local SampleTimestampTable TimeContext::sample_timestamps;
 
 } // namespace dear
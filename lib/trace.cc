@@ -0,0 +1,192 @@
+/*
+ * Copyright (C) 2020 TU Dresden
+ * All rights reserved.
+ *
+ * Authors:
+ *   Christian Menard
+ */
+
+#include "dear/trace.hh"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <system_error>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace dear {
+
+// File layout:
+//
+//   [ file header | record | record | ... ]
+//
+// Each record starts with a record header followed by its payload and is
+// padded to a multiple of 8 bytes. The size field of a record is written
+// last, so that a record with size 0 marks the end of the trace even if the
+// writer did not shut down cleanly. Transactor records carry the name of a
+// transactor as payload and define its id.
+namespace {
+
+constexpr std::uint64_t kMagic = 0x3143525441454400;  // "\0DEATRC1"
+
+struct FileHeader {
+  std::uint64_t magic;
+  // number of bytes used, including this header
+  std::uint64_t length;
+};
+
+struct RecordHeader {
+  std::uint32_t size;
+  std::uint16_t kind;
+  std::uint16_t reserved;
+  std::uint32_t transactor_id;
+  std::uint32_t payload_size;
+  std::int64_t timestamp;
+  std::int64_t arrival;
+};
+
+static_assert(sizeof(RecordHeader) % 8 == 0, "records must stay aligned");
+
+constexpr std::size_t round_up(std::size_t value) { return (value + 7) & ~7ul; }
+
+[[noreturn]] void throw_errno(const std::string& what) {
+  throw std::system_error(errno, std::generic_category(), what);
+}
+
+}  // namespace
+
+TraceWriter::TraceWriter(const std::string& path, std::size_t capacity)
+    : path_(path), capacity_(capacity), tail(sizeof(FileHeader)) {
+  int fd = open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+  if (fd == -1) {
+    throw_errno("open " + path);
+  }
+  // the file stays sparse until records are written
+  if (ftruncate(fd, static_cast<off_t>(capacity)) == -1) {
+    close(fd);
+    throw_errno("ftruncate " + path);
+  }
+  void* p = mmap(nullptr, capacity, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd);
+  if (p == MAP_FAILED) {
+    throw_errno("mmap " + path);
+  }
+  data = static_cast<std::uint8_t*>(p);
+
+  auto header = reinterpret_cast<FileHeader*>(data);
+  header->magic = kMagic;
+  header->length = 0;
+}
+
+TraceWriter::~TraceWriter() {
+  auto length = std::min(tail.load(), capacity_);
+  reinterpret_cast<FileHeader*>(data)->length = length;
+  munmap(data, capacity_);
+  // Drop the unused part of the file. If this fails, the trace is still
+  // readable, only larger than necessary.
+  int result = truncate(path_.c_str(), static_cast<off_t>(length));
+  (void)result;
+}
+
+std::uint32_t TraceWriter::register_transactor(const std::string& name) {
+  std::lock_guard<std::mutex> lock(names_mutex);
+  auto id = static_cast<std::uint32_t>(names.size());
+  names.push_back(name);
+  append(kTransactor, id, {}, {}, name.data(), name.size());
+  return id;
+}
+
+bool TraceWriter::append(std::uint16_t kind,
+                         std::uint32_t transactor_id,
+                         const reactor::TimePoint& timestamp,
+                         const reactor::TimePoint& arrival,
+                         const void* payload,
+                         std::size_t size) {
+  auto record_size = round_up(sizeof(RecordHeader) + size);
+  auto offset = tail.fetch_add(record_size, std::memory_order_relaxed);
+  if (offset + record_size > capacity_) {
+    dropped_records_.fetch_add(1, std::memory_order_relaxed);
+    return false;
+  }
+
+  auto header = reinterpret_cast<RecordHeader*>(data + offset);
+  header->kind = kind;
+  header->reserved = 0;
+  header->transactor_id = transactor_id;
+  header->payload_size = static_cast<std::uint32_t>(size);
+  header->timestamp = timestamp.time_since_epoch().count();
+  header->arrival = arrival.time_since_epoch().count();
+  std::memcpy(data + offset + sizeof(RecordHeader), payload, size);
+  // publish the record
+  __atomic_store_n(&header->size, static_cast<std::uint32_t>(record_size),
+                   __ATOMIC_RELEASE);
+  return true;
+}
+
+TraceReader::TraceReader(const std::string& path) {
+  int fd = open(path.c_str(), O_RDONLY);
+  if (fd == -1) {
+    throw_errno("open " + path);
+  }
+  struct stat st;
+  if (fstat(fd, &st) == -1) {
+    close(fd);
+    throw_errno("fstat " + path);
+  }
+  size = static_cast<std::size_t>(st.st_size);
+  if (size < sizeof(FileHeader)) {
+    close(fd);
+    throw std::system_error(std::make_error_code(std::errc::invalid_argument),
+                            "not a trace file " + path);
+  }
+  void* p = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (p == MAP_FAILED) {
+    throw_errno("mmap " + path);
+  }
+  data = static_cast<const std::uint8_t*>(p);
+
+  auto header = reinterpret_cast<const FileHeader*>(data);
+  if (header->magic != kMagic) {
+    munmap(const_cast<std::uint8_t*>(data), size);
+    throw std::system_error(std::make_error_code(std::errc::invalid_argument),
+                            "not a trace file " + path);
+  }
+  // a trace that was not closed properly has no length yet
+  auto length = header->length != 0
+                    ? std::min<std::size_t>(header->length, size)
+                    : size;
+
+  std::size_t offset = sizeof(FileHeader);
+  while (offset + sizeof(RecordHeader) <= length) {
+    auto record = reinterpret_cast<const RecordHeader*>(data + offset);
+    if (record->size == 0 || offset + record->size > length) {
+      break;
+    }
+    auto payload = data + offset + sizeof(RecordHeader);
+    if (record->kind == TraceWriter::kTransactor) {
+      if (names.size() <= record->transactor_id) {
+        names.resize(record->transactor_id + 1);
+      }
+      names[record->transactor_id].assign(
+          reinterpret_cast<const char*>(payload), record->payload_size);
+    } else if (record->kind == TraceWriter::kMessage) {
+      records_.push_back(TraceRecord{
+          record->transactor_id,
+          reactor::TimePoint{reactor::Duration{record->timestamp}},
+          reactor::TimePoint{reactor::Duration{record->arrival}}, payload,
+          record->payload_size});
+    }
+    offset += record->size;
+  }
+}
+
+TraceReader::~TraceReader() {
+  munmap(const_cast<std::uint8_t*>(data), size);
+}
+
+}  // namespace dear
@@ -0,0 +1,59 @@
+/*
+ * Copyright (C) 2020 TU Dresden
+ * All rights reserved.
+ *
+ * Authors:
+ *   Christian Menard
+ */
+
+#include "dear/worker_pool.hh"
+
+#include <cassert>
+#include <utility>
+
+namespace dear {
+
+WorkerPool::WorkerPool(std::size_t num_threads) {
+  assert(num_threads > 0);
+  threads.reserve(num_threads);
+  for (std::size_t i = 0; i < num_threads; i++) {
+    threads.emplace_back([this]() { run(); });
+  }
+}
+
+WorkerPool::~WorkerPool() {
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    stopped = true;
+  }
+  cv.notify_all();
+  for (auto& thread : threads) {
+    thread.join();
+  }
+}
+
+void WorkerPool::submit(std::function<void()> job) {
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    jobs.push_back(std::move(job));
+  }
+  cv.notify_one();
+}
+
+void WorkerPool::run() {
+  std::unique_lock<std::mutex> lock(mutex);
+  while (true) {
+    cv.wait(lock, [this]() { return stopped || !jobs.empty(); });
+    if (jobs.empty()) {
+      // stopped and nothing left to do
+      return;
+    }
+    auto job = std::move(jobs.front());
+    jobs.pop_front();
+    lock.unlock();
+    job();
+    lock.lock();
+  }
+}
+
+}  // namespace dear